@@ -0,0 +1,259 @@
+/* pluginBenchmark.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+/*
+ * Measures the cost of the copy plugins on large arrays and at high update rates.
+ * The correctness checks are in test/src/testPlugin.cpp.
+ */
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cmath>
+
+#include <epicsTime.h>
+
+#include <pv/pvData.h>
+#include <pv/standardPVField.h>
+#include <pv/createRequest.h>
+#include <pv/pvStructureCopy.h>
+#include <pv/pvDatabase.h>
+#include <pv/pvCompressPlugin.h>
+
+using namespace std;
+using namespace epics::pvData;
+using namespace epics::pvCopy;
+using namespace epics::pvDatabase;
+
+// Creates a copy of pvMaster made with request.
+struct Copy
+{
+    PVCopyPtr pvCopy;
+    PVStructurePtr pvStructureCopy;
+    BitSetPtr bitSet;
+    Copy(PVStructurePtr const & pvMaster,string const & request)
+    : pvCopy(PVCopy::create(pvMaster,CreateRequest::create()->createRequest(request),"")),
+      pvStructureCopy(pvCopy->createPVStructure()),
+      bitSet(new BitSet(pvStructureCopy->getNumberFields()))
+    {
+    }
+    bool update()
+    {
+        bitSet->clear();
+        return pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    }
+    // Returns the seconds per update of n updates.
+    double time(int n)
+    {
+        epicsTime start = epicsTime::getCurrent();
+        for(int i=0; i<n; ++i) update();
+        return (epicsTime::getCurrent() - start)/n;
+    }
+};
+
+static void deadbandBenchmark()
+{
+    // updates at a high rate, every tenth one outside the deadband
+    const ScalarType types[] = {pvDouble,pvLong};
+    const size_t nupdate = 1000000;
+    for(size_t k=0; k<sizeof(types)/sizeof(types[0]); ++k) {
+        PVStructurePtr pvStructure(getStandardPVField()->scalar(types[k],""));
+        Copy copy(pvStructure,"value[deadband=abs:10]");
+        PVScalarPtr pvValue(pvStructure->getSubField<PVScalar>("value"));
+        size_t nreport = 0;
+        epicsTime start = epicsTime::getCurrent();
+        for(size_t i=0; i<nupdate; i++) {
+            pvValue->putFrom<int64>(int64(i));
+            if(copy.update()) ++nreport;
+        }
+        double elapsed = epicsTime::getCurrent() - start;
+        cout << "deadband " << ScalarTypeFunc::name(types[k]) << " " << nupdate
+             << " updates " << nreport << " reported " << elapsed << " seconds\n";
+    }
+}
+
+static void whereBenchmark()
+{
+    // the condition alternates
+    PVStructurePtr pvStructure(getStandardPVField()->scalar(pvDouble,"alarm"));
+    PVDoublePtr pvValue(pvStructure->getSubField<PVDouble>("value"));
+    pvStructure->getSubField<PVInt>("alarm.severity")->put(1);
+    Copy copy(pvStructure,"value[where=alarm.severity>0&&value>10]");
+    const size_t nupdate = 1000000;
+    epicsTime start = epicsTime::getCurrent();
+    for(size_t i=0; i<nupdate; i++) {
+        pvValue->put((i%2) ? 15.0 : 5.0);
+        copy.update();
+    }
+    double elapsed = epicsTime::getCurrent() - start;
+    cout << "where " << nupdate << " updates " << elapsed << " seconds\n";
+}
+
+static PVStructurePtr createWaveform(size_t n,double step)
+{
+    PVStructurePtr pvStructure(getStandardPVField()->scalarArray(pvDouble,""));
+    shared_vector<double> values(n);
+    for(size_t i=0; i<n; i++) values[i] = 1000.0*sin(i*step);
+    pvStructure->getSubField<PVDoubleArray>("value")->replace(freeze(values));
+    return pvStructure;
+}
+
+static void strideBenchmark()
+{
+    const size_t n = 10000000;
+    const int nloop = 10;
+    PVStructurePtr pvStructure(createWaveform(n,1e-3));
+    const long strides[] = {1,2,10,100};
+    for(size_t k=0; k<sizeof(strides)/sizeof(strides[0]); ++k) {
+        std::stringstream request;
+        request << "value[array=0:" << strides[k] << ":-1]";
+        Copy copy(pvStructure,request.str());
+        cout << "stride " << strides[k] << ": " << copy.time(nloop)*1e3
+             << " ms per copy of " << n << " elements\n";
+    }
+}
+
+static void binBenchmark()
+{
+    // a 1000 point overview of a 10M point waveform
+    const size_t n = 10000000;
+    PVStructurePtr pvStructure(createWaveform(n,1e-3));
+    const char * modes[] = {"mean","minmax","lttb"};
+    for(size_t k=0; k<sizeof(modes)/sizeof(modes[0]); ++k) {
+        Copy copy(pvStructure,string("value[bin=1000:") + modes[k] + "]");
+        cout << "bin " << modes[k] << ": " << copy.time(1)*1e3
+             << " ms for " << n << " elements\n";
+    }
+}
+
+// Creates a structure with the value and dimension fields of an NTNDArray
+// that holds an nx by ny ushort image with value y*100+x.
+static PVStructurePtr createImage(size_t nx,size_t ny)
+{
+    FieldCreatePtr fieldCreate = getFieldCreate();
+    StructureConstPtr top = fieldCreate->createFieldBuilder()->
+        addNestedUnion("value") ->
+            addArray("ubyteValue",pvUByte) ->
+            addArray("ushortValue",pvUShort) ->
+            endNested()->
+        addNestedStructureArray("dimension") ->
+            add("size",pvInt) ->
+            add("offset",pvInt) ->
+            add("fullSize",pvInt) ->
+            add("binning",pvInt) ->
+            add("reverse",pvBoolean) ->
+            endNested()->
+        createStructure();
+    PVStructurePtr pvStructure(getPVDataCreate()->createPVStructure(top));
+    shared_vector<uint16> values(nx*ny);
+    for(size_t j=0; j<ny; ++j) {
+        for(size_t i=0; i<nx; ++i) values[j*nx + i] = static_cast<uint16>(j*100 + i);
+    }
+    pvStructure->getSubField<PVUnion>("value")->select<PVUShortArray>("ushortValue")->replace(freeze(values));
+    PVStructureArrayPtr pvDimension(pvStructure->getSubField<PVStructureArray>("dimension"));
+    PVStructureArray::svector dims(2);
+    size_t sizes[2] = {nx,ny};
+    for(size_t i=0; i<2; ++i) {
+        dims[i] = getPVDataCreate()->createPVStructure(pvDimension->getStructureArray()->getStructure());
+        dims[i]->getSubField<PVInt>("size")->put(static_cast<int32>(sizes[i]));
+        dims[i]->getSubField<PVInt>("fullSize")->put(static_cast<int32>(sizes[i]));
+        dims[i]->getSubField<PVInt>("binning")->put(1);
+    }
+    pvDimension->replace(freeze(dims));
+    return pvStructure;
+}
+
+static void roiBenchmark()
+{
+    // a 4 MP frame
+    PVStructurePtr pvImage(createImage(2048,2048));
+    const char * requests[] = {
+        "field(value[roi=512:512:1024:1024],dimension)",
+        "field(value[roi=0:0:0:0:2:2],dimension)"};
+    const int nframe = 20;
+    for(size_t k=0; k<sizeof(requests)/sizeof(requests[0]); ++k) {
+        Copy copy(pvImage,requests[k]);
+        cout << requests[k] << " " << copy.time(nframe)*1e3
+             << " ms per 2048x2048 frame\n";
+    }
+}
+
+static void convertBenchmark()
+{
+    // 4M elements
+    PVStructurePtr pvStructure(createWaveform(4*1024*1024,1e-3));
+    const char * requests[] = {"value[convert=float]","value[convert=short:0.1]"};
+    const int nupdate = 20;
+    for(size_t k=0; k<sizeof(requests)/sizeof(requests[0]); ++k) {
+        Copy copy(pvStructure,requests[k]);
+        cout << requests[k] << " " << copy.time(nupdate)*1e3
+             << " ms per 4M elements\n";
+    }
+}
+
+static void compressBenchmark()
+{
+    // a detector frame, a peak on a background with noise
+    size_t width = 2048;
+    size_t height = 2048;
+    shared_vector<uint16> frame(width*height);
+    uint32 random = 1;
+    for(size_t y=0; y<height; ++y) {
+        for(size_t x=0; x<width; ++x) {
+            double dx = x - 1024.0;
+            double dy = y - 1024.0;
+            random = random*1103515245 + 12345;
+            frame[y*width + x] = static_cast<uint16>(
+                1000 + 800*exp(-(dx*dx + dy*dy)/2e5) + (random >> 28));
+        }
+    }
+    PVStructurePtr pvImage(getStandardPVField()->scalarArray(pvUShort,""));
+    pvImage->getSubField<PVUShortArray>("value")->replace(freeze(frame));
+    Copy copy(pvImage,"value[compress=delta]");
+    const int nframe = 20;
+    double encode = copy.time(nframe);
+    PVUByteArrayPtr pvEncoded(copy.pvStructureCopy->getSubField<PVUByteArray>("value"));
+    PVScalarArrayPtr pvDecoded;
+    epicsTime start = epicsTime::getCurrent();
+    for(int i=0; i<nframe; ++i) pvDecoded = PVCompressPlugin::decode(pvEncoded->view());
+    double decode = (epicsTime::getCurrent() - start)/nframe;
+    double bytes = width*height*sizeof(uint16);
+    cout << "compress ratio " << bytes/pvEncoded->getLength()
+         << " encode " << encode*1e3 << " ms " << bytes/encode*1e-6 << " MB/s"
+         << " decode " << decode*1e3 << " ms per 2048x2048 frame\n";
+}
+
+struct Benchmark
+{
+    const char * name;
+    void (*run)();
+};
+
+static const Benchmark benchmarks[] = {
+    {"deadband",deadbandBenchmark},
+    {"where",whereBenchmark},
+    {"stride",strideBenchmark},
+    {"bin",binBenchmark},
+    {"roi",roiBenchmark},
+    {"convert",convertBenchmark},
+    {"compress",compressBenchmark}};
+
+int main(int argc,char *argv[])
+{
+    const size_t number = sizeof(benchmarks)/sizeof(benchmarks[0]);
+    if(argc>1 && string(argv[1])=="-h") {
+        cout << "pluginBenchmark [name ...]\nnames:";
+        for(size_t i=0; i<number; ++i) cout << " " << benchmarks[i].name;
+        cout << "\nwithout a name all are run\n";
+        return 0;
+    }
+    // the plugins are registered by the master database
+    PVDatabasePtr master(PVDatabase::getMaster());
+    for(size_t i=0; i<number; ++i) {
+        bool selected = argc<2;
+        for(int j=1; !selected && j<argc; ++j) selected = string(argv[j])==benchmarks[i].name;
+        if(selected) benchmarks[i].run();
+    }
+    return 0;
+}
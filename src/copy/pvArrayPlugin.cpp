@@ -54,6 +54,76 @@ PVArrayFilter::~PVArrayFilter()
 {
 }
 
+// Copies len elements of master, from start with stride increment, to copy.
+template<typename T>
+static void gatherArray(
+    PVScalarArray const & masterArray,long start,long increment,long len,
+    PVScalarArray & copyArray)
+{
+    typename PVValueArray<T>::const_svector from(
+        static_cast<PVValueArray<T> const &>(masterArray).view());
+    PVValueArray<T> & to = static_cast<PVValueArray<T> &>(copyArray);
+    // the old elements are overwritten, a buffer still shared is not copied
+    typename PVValueArray<T>::const_svector current;
+    to.swap(current);
+    typename PVValueArray<T>::svector values;
+    if(current.unique()) values = thaw(current);
+    values.resize(len);
+    const T * src = from.data() + start;
+    T * dst = values.data();
+    for(long i=0; i<len; ++i) dst[i] = src[i*increment];
+    to.replace(freeze(values));
+}
+
+// Copies len elements of copy to master, from start with stride increment.
+template<typename T>
+static void scatterArray(
+    PVScalarArray const & copyArray,long start,long increment,long len,
+    PVScalarArray & masterArray)
+{
+    typename PVValueArray<T>::const_svector from(
+        static_cast<PVValueArray<T> const &>(copyArray).view());
+    if(len>long(from.size())) len = from.size();
+    if(len<=0) return;
+    PVValueArray<T> & to = static_cast<PVValueArray<T> &>(masterArray);
+    typename PVValueArray<T>::svector values(to.reuse());
+    size_t length = start + (len-1)*increment + 1;
+    if(values.size()<length) values.resize(length);
+    const T * src = from.data();
+    T * dst = values.data() + start;
+    for(long i=0; i<len; ++i) dst[i*increment] = src[i];
+    to.replace(freeze(values));
+}
+
+// The typed strided copy, false for string arrays.
+static bool stridedCopy(
+    PVScalarArray const & from,long start,long increment,long len,
+    PVScalarArray & to,bool gather)
+{
+    switch(from.getScalarArray()->getElementType()) {
+#define STRIDED_CASE(PVTYPE,T) \
+    case PVTYPE: \
+        if(gather) { gatherArray<T>(from,start,increment,len,to); } \
+        else { scatterArray<T>(from,start,increment,len,to); } \
+        return true;
+    STRIDED_CASE(pvBoolean,boolean)
+    STRIDED_CASE(pvByte,int8)
+    STRIDED_CASE(pvShort,int16)
+    STRIDED_CASE(pvInt,int32)
+    STRIDED_CASE(pvLong,int64)
+    STRIDED_CASE(pvUByte,uint8)
+    STRIDED_CASE(pvUShort,uint16)
+    STRIDED_CASE(pvUInt,uint32)
+    STRIDED_CASE(pvULong,uint64)
+    STRIDED_CASE(pvFloat,float)
+    STRIDED_CASE(pvDouble,double)
+#undef STRIDED_CASE
+    case pvString:
+        break;
+    }
+    return false;
+}
+
 static vector<string> split(string const & colonSeparatedList) {
     string::size_type numValues = 1;
     string::size_type index=0;
@@ -185,6 +255,10 @@ bool PVArrayFilter::filter(const PVFieldPtr & pvField,const BitSetPtr & bitSet,b
         }
         long indfrom = start;
         long indto = 0;
+        if(increment!=1 && stridedCopy(*masterArray,start,increment,len,*copyArray,true)) {
+            bitSet->set(pvField->getFieldOffset());
+            return true;
+        }
         copyArray->setCapacity(len);
         if(increment==1) {
             copy(*masterArray,indfrom,1,*copyArray,indto,1,len);
@@ -202,6 +276,10 @@ bool PVArrayFilter::filter(const PVFieldPtr & pvField,const BitSetPtr & bitSet,b
     if (end - start >= 0) len = 1 + (end - start) / increment;
     if(len<=0) return true;
     if(no_elements<=end) masterArray->setLength(end+1);
+    if(increment!=1 && stridedCopy(*copyArray,start,increment,len,*masterArray,false)) {
+        if(isUnion) masterField->postPut();
+        return true;
+    }
     long indfrom = 0;
     long indto = start;
     if(increment==1) {
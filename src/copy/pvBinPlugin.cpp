@@ -0,0 +1,249 @@
+/* pvBinPlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <stdlib.h>
+#include <cmath>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvBinPlugin.h"
+
+using std::string;
+using std::size_t;
+using std::tr1::static_pointer_cast;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("bin");
+
+PVBinPlugin::PVBinPlugin()
+{
+}
+
+PVBinPlugin::~PVBinPlugin()
+{
+}
+
+void PVBinPlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVBinPluginPtr pvPlugin = PVBinPluginPtr(new PVBinPlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVBinPlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVBinFilter::create(requestValue,master);
+}
+
+PVBinFilter::~PVBinFilter()
+{
+}
+
+PVBinFilterPtr PVBinFilter::create(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    FieldConstPtr field = master->getField();
+    if(field->getType()!=scalarArray) return PVBinFilterPtr();
+    ScalarType elementType = static_pointer_cast<const ScalarArray>(field)->getElementType();
+    if(!ScalarTypeFunc::isNumeric(elementType)) return PVBinFilterPtr();
+    string::size_type pos = requestValue.find(':');
+    string number = requestValue.substr(0,pos);
+    char * end = 0;
+    long numberBins = strtol(number.c_str(),&end,10);
+    if(number.empty() || *end!=0 || numberBins<1) return PVBinFilterPtr();
+    Mode mode = mean;
+    if(pos!=string::npos) {
+        string value = requestValue.substr(pos+1);
+        if(value=="mean") {
+            mode = mean;
+        } else if(value=="minmax") {
+            mode = minmax;
+        } else if(value=="lttb") {
+            mode = lttb;
+        } else {
+            return PVBinFilterPtr();
+        }
+    }
+    // lttb always keeps the first and the last element
+    if(mode==lttb && numberBins<3) return PVBinFilterPtr();
+    PVBinFilterPtr filter = PVBinFilterPtr(
+        new PVBinFilter(numberBins,mode,static_pointer_cast<PVScalarArray>(master)));
+    return filter;
+}
+
+PVBinFilter::PVBinFilter(
+    size_t numberBins,Mode mode,
+    const PVScalarArrayPtr & masterArray)
+: numberBins(numberBins),
+  mode(mode),
+  masterArray(masterArray)
+{
+}
+
+// The index of the first element of bin b of numberBins bins of n elements.
+static inline size_t binStart(size_t b,size_t n,size_t numberBins)
+{
+    return static_cast<size_t>(static_cast<uint64>(b)*n/numberBins);
+}
+
+// The kernels keep numberLanes independent partial results,
+// so the compiler can vectorize the loops over a bin.
+enum {numberLanes = 8};
+
+template<typename T>
+static void binMean(const T * data,size_t n,size_t numberBins,T * out)
+{
+    for(size_t b=0; b<numberBins; ++b) {
+        size_t first = binStart(b,n,numberBins);
+        size_t last = binStart(b+1,n,numberBins);
+        double sums[numberLanes] = {0.0};
+        size_t i = first;
+        for(; i+numberLanes<=last; i+=numberLanes) {
+            for(int k=0; k<numberLanes; ++k) sums[k] += data[i+k];
+        }
+        for(; i<last; ++i) sums[0] += data[i];
+        double sum = 0.0;
+        for(int k=0; k<numberLanes; ++k) sum += sums[k];
+        out[b] = static_cast<T>(sum/(last-first));
+    }
+}
+
+template<typename T>
+static void binMinMax(const T * data,size_t n,size_t numberBins,T * out)
+{
+    for(size_t b=0; b<numberBins; ++b) {
+        size_t first = binStart(b,n,numberBins);
+        size_t last = binStart(b+1,n,numberBins);
+        T mins[numberLanes];
+        T maxs[numberLanes];
+        for(int k=0; k<numberLanes; ++k) mins[k] = maxs[k] = data[first];
+        size_t i = first;
+        for(; i+numberLanes<=last; i+=numberLanes) {
+            for(int k=0; k<numberLanes; ++k) {
+                T value = data[i+k];
+                mins[k] = value<mins[k] ? value : mins[k];
+                maxs[k] = value>maxs[k] ? value : maxs[k];
+            }
+        }
+        for(; i<last; ++i) {
+            T value = data[i];
+            mins[0] = value<mins[0] ? value : mins[0];
+            maxs[0] = value>maxs[0] ? value : maxs[0];
+        }
+        T min = mins[0];
+        T max = maxs[0];
+        for(int k=1; k<numberLanes; ++k) {
+            min = mins[k]<min ? mins[k] : min;
+            max = maxs[k]>max ? maxs[k] : max;
+        }
+        // the one that occurs first goes first
+        size_t j = first;
+        while(j<last && data[j]!=min && data[j]!=max) ++j;
+        bool minFirst = (j==last || data[j]==min);
+        out[2*b] = minFirst ? min : max;
+        out[2*b+1] = minFirst ? max : min;
+    }
+}
+
+// Largest triangle three buckets: the first and last element are kept and
+// of each bin between them the element that makes the largest triangle with
+// the element selected from the previous bin and the mean of the next bin.
+template<typename T>
+static void binLttb(const T * data,size_t n,size_t numberBins,T * out)
+{
+    size_t numberInner = numberBins - 2;
+    size_t selected = 0;
+    out[0] = data[0];
+    for(size_t b=0; b<numberInner; ++b) {
+        size_t first = 1 + binStart(b,n-2,numberInner);
+        size_t last = 1 + binStart(b+1,n-2,numberInner);
+        size_t nextFirst = last;
+        size_t nextLast = (b+1==numberInner) ? n : 1 + binStart(b+2,n-2,numberInner);
+        double meanX = 0.5*(nextFirst + nextLast - 1);
+        double meanY = 0.0;
+        for(size_t i=nextFirst; i<nextLast; ++i) meanY += data[i];
+        meanY /= (nextLast - nextFirst);
+        double x = selected;
+        double y = data[selected];
+        double maxArea = -1.0;
+        size_t next = first;
+        for(size_t i=first; i<last; ++i) {
+            double area = std::fabs((x - meanX)*(data[i] - y) - (x - i)*(meanY - y));
+            if(area>maxArea) {
+                maxArea = area;
+                next = i;
+            }
+        }
+        out[b+1] = data[next];
+        selected = next;
+    }
+    out[numberBins-1] = data[n-1];
+}
+
+template<typename T>
+static void binArray(
+    PVScalarArray const & masterArray,size_t numberBins,PVBinFilter::Mode mode,
+    PVScalarArray & copyArray)
+{
+    typename PVValueArray<T>::const_svector from(
+        static_cast<PVValueArray<T> const &>(masterArray).view());
+    PVValueArray<T> & to = static_cast<PVValueArray<T> &>(copyArray);
+    size_t n = from.size();
+    size_t length = (mode==PVBinFilter::minmax) ? 2*numberBins : numberBins;
+    if(n<=length) {
+        // nothing to reduce, the buffer is shared
+        to.replace(from);
+        return;
+    }
+    typename PVValueArray<T>::const_svector current;
+    to.swap(current);
+    typename PVValueArray<T>::svector values;
+    if(current.unique()) values = thaw(current);
+    values.resize(length);
+    switch(mode) {
+    case PVBinFilter::mean: binMean<T>(from.data(),n,numberBins,values.data()); break;
+    case PVBinFilter::minmax: binMinMax<T>(from.data(),n,numberBins,values.data()); break;
+    case PVBinFilter::lttb: binLttb<T>(from.data(),n,numberBins,values.data()); break;
+    }
+    to.replace(freeze(values));
+}
+
+bool PVBinFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    // the bins can not be put back into the master
+    if(!toCopy) return true;
+    PVScalarArray & copyArray = static_cast<PVScalarArray &>(*pvCopy);
+    switch(masterArray->getScalarArray()->getElementType()) {
+    case pvByte:    binArray<int8>(*masterArray,numberBins,mode,copyArray); break;
+    case pvShort:   binArray<int16>(*masterArray,numberBins,mode,copyArray); break;
+    case pvInt:     binArray<int32>(*masterArray,numberBins,mode,copyArray); break;
+    case pvLong:    binArray<int64>(*masterArray,numberBins,mode,copyArray); break;
+    case pvUByte:   binArray<uint8>(*masterArray,numberBins,mode,copyArray); break;
+    case pvUShort:  binArray<uint16>(*masterArray,numberBins,mode,copyArray); break;
+    case pvUInt:    binArray<uint32>(*masterArray,numberBins,mode,copyArray); break;
+    case pvULong:   binArray<uint64>(*masterArray,numberBins,mode,copyArray); break;
+    case pvFloat:   binArray<float>(*masterArray,numberBins,mode,copyArray); break;
+    case pvDouble:  binArray<double>(*masterArray,numberBins,mode,copyArray); break;
+    default: return false;
+    }
+    bitSet->set(pvCopy->getFieldOffset());
+    return true;
+}
+
+string PVBinFilter::getName()
+{
+    return name;
+}
+
+}}
@@ -0,0 +1,305 @@
+/* pvCompressPlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvCompressPlugin.h"
+
+using std::string;
+using std::size_t;
+using std::tr1::static_pointer_cast;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("compress");
+
+static const uint8 codecDelta = 1;
+static const size_t headerLength = 8;
+static const size_t blockLength = 128;
+
+// The unsigned type with the size of an element, differences wrap around in it.
+template<typename T> struct CompressUnsigned {};
+template<> struct CompressUnsigned<int8> {typedef uint8 type;};
+template<> struct CompressUnsigned<int16> {typedef uint16 type;};
+template<> struct CompressUnsigned<int32> {typedef uint32 type;};
+template<> struct CompressUnsigned<int64> {typedef uint64 type;};
+template<> struct CompressUnsigned<uint8> {typedef uint8 type;};
+template<> struct CompressUnsigned<uint16> {typedef uint16 type;};
+template<> struct CompressUnsigned<uint32> {typedef uint32 type;};
+template<> struct CompressUnsigned<uint64> {typedef uint64 type;};
+
+// Packs bits shift to shift+width of each value, width is 1 to 32.
+// A full block is a multiple of 32 bits, only the last block ends with a partial word.
+template<typename U>
+static uint8 * packBits(const U * values,size_t count,unsigned width,unsigned shift,uint8 * out)
+{
+    const uint64 mask = (static_cast<uint64>(1) << width) - 1;
+    uint64 accumulator = 0;
+    unsigned nbits = 0;
+    for(size_t i=0; i<count; ++i) {
+        accumulator |= ((static_cast<uint64>(values[i]) >> shift) & mask) << nbits;
+        nbits += width;
+        if(nbits>=32) {
+            out[0] = static_cast<uint8>(accumulator);
+            out[1] = static_cast<uint8>(accumulator >> 8);
+            out[2] = static_cast<uint8>(accumulator >> 16);
+            out[3] = static_cast<uint8>(accumulator >> 24);
+            out += 4;
+            accumulator >>= 32;
+            nbits -= 32;
+        }
+    }
+    for(; nbits>0; nbits = nbits>8 ? nbits - 8 : 0) {
+        *out++ = static_cast<uint8>(accumulator);
+        accumulator >>= 8;
+    }
+    return out;
+}
+
+// The inverse of packBits, values must be 0 for the bits it sets.
+template<typename U>
+static const uint8 * unpackBits(const uint8 * in,size_t count,unsigned width,unsigned shift,U * values)
+{
+    const uint64 mask = (static_cast<uint64>(1) << width) - 1;
+    size_t nbytes = (count*width + 7)/8;
+    const uint8 * end = in + nbytes;
+    uint64 accumulator = 0;
+    unsigned nbits = 0;
+    for(size_t i=0; i<count; ++i) {
+        if(nbits<width) {
+            if(end - in>=4) {
+                accumulator |= (static_cast<uint64>(in[0])
+                    | static_cast<uint64>(in[1]) << 8
+                    | static_cast<uint64>(in[2]) << 16
+                    | static_cast<uint64>(in[3]) << 24) << nbits;
+                in += 4;
+                nbits += 32;
+            } else {
+                while(in<end) {
+                    accumulator |= static_cast<uint64>(*in++) << nbits;
+                    nbits += 8;
+                }
+            }
+        }
+        values[i] |= static_cast<U>((accumulator & mask) << shift);
+        accumulator >>= width;
+        nbits -= width;
+    }
+    return end;
+}
+
+static size_t packedLength(size_t count,unsigned width)
+{
+    size_t low = width<32 ? width : 32;
+    return (count*low + 7)/8 + (count*(width - low) + 7)/8;
+}
+
+// Encodes a block of count elements after previous.
+// The differences and their width are loops without branches, the compiler vectorizes them.
+template<typename T>
+static uint8 * encodeBlock(const T * from,size_t count,T previous,uint8 * out)
+{
+    typedef typename CompressUnsigned<T>::type U;
+    const unsigned bits = sizeof(U)*8;
+    U zigzag[blockLength];
+    zigzag[0] = static_cast<U>(from[0]) - static_cast<U>(previous);
+    for(size_t i=1; i<count; ++i) zigzag[i] = static_cast<U>(from[i]) - static_cast<U>(from[i-1]);
+    U all = 0;
+    for(size_t i=0; i<count; ++i) {
+        U difference = zigzag[i];
+        zigzag[i] = static_cast<U>(static_cast<U>(difference << 1) ^ static_cast<U>(U(0) - (difference >> (bits - 1))));
+        all |= zigzag[i];
+    }
+    unsigned width = 0;
+    while(width<bits && (static_cast<uint64>(all) >> width)!=0) ++width;
+    *out++ = static_cast<uint8>(width);
+    if(width==0) return out;
+    out = packBits(zigzag,count,width<32 ? width : 32,0,out);
+    if(width>32) out = packBits(zigzag,count,width - 32,32,out);
+    return out;
+}
+
+template<typename T>
+static const uint8 * decodeBlock(const uint8 * in,const uint8 * end,size_t count,T previous,T * to)
+{
+    typedef typename CompressUnsigned<T>::type U;
+    const unsigned bits = sizeof(U)*8;
+    if(in>=end) return 0;
+    unsigned width = *in++;
+    if(width>bits || static_cast<size_t>(end - in)<packedLength(count,width)) return 0;
+    U zigzag[blockLength];
+    for(size_t i=0; i<count; ++i) zigzag[i] = 0;
+    if(width>0) in = unpackBits(in,count,width<32 ? width : 32,0,zigzag);
+    if(width>32) in = unpackBits(in,count,width - 32,32,zigzag);
+    U value = static_cast<U>(previous);
+    for(size_t i=0; i<count; ++i) {
+        U difference = static_cast<U>((zigzag[i] >> 1) ^ static_cast<U>(U(0) - (zigzag[i] & 1)));
+        value = static_cast<U>(value + difference);
+        to[i] = static_cast<T>(value);
+    }
+    return in;
+}
+
+template<typename T>
+static void encodeArray(PVScalarArray const & masterArray,ScalarType type,PVScalarArray & copyArray)
+{
+    typename PVValueArray<T>::const_svector from(
+        static_cast<PVValueArray<T> const &>(masterArray).view());
+    PVUByteArray & to = static_cast<PVUByteArray &>(copyArray);
+    PVUByteArray::const_svector current;
+    to.swap(current);
+    PVUByteArray::svector values;
+    if(current.unique()) values = thaw(current);
+    size_t n = from.size();
+    size_t nblock = (n + blockLength - 1)/blockLength;
+    values.resize(headerLength + nblock + n*sizeof(T));
+    uint8 * out = values.data();
+    out[0] = codecDelta;
+    out[1] = static_cast<uint8>(type);
+    out[2] = 0;
+    out[3] = 0;
+    for(int i=0; i<4; ++i) out[4 + i] = static_cast<uint8>(static_cast<uint32>(n) >> (8*i));
+    out += headerLength;
+    T previous = 0;
+    for(size_t first=0; first<n; first+=blockLength) {
+        size_t count = n - first<blockLength ? n - first : blockLength;
+        out = encodeBlock<T>(from.data() + first,count,previous,out);
+        previous = from[first + count - 1];
+    }
+    values.resize(out - values.data());
+    to.replace(freeze(values));
+}
+
+template<typename T>
+static PVScalarArrayPtr decodeArray(const uint8 * in,const uint8 * end,size_t n,ScalarType type)
+{
+    typename PVValueArray<T>::svector values(n);
+    T previous = 0;
+    for(size_t first=0; first<n; first+=blockLength) {
+        size_t count = n - first<blockLength ? n - first : blockLength;
+        in = decodeBlock<T>(in,end,count,previous,values.data() + first);
+        if(!in) return PVScalarArrayPtr();
+        previous = values[first + count - 1];
+    }
+    if(in!=end) return PVScalarArrayPtr();
+    std::tr1::shared_ptr<PVValueArray<T> > pvArray =
+        static_pointer_cast<PVValueArray<T> >(getPVDataCreate()->createPVScalarArray(type));
+    pvArray->replace(freeze(values));
+    return pvArray;
+}
+
+PVCompressPlugin::PVCompressPlugin()
+{
+}
+
+PVCompressPlugin::~PVCompressPlugin()
+{
+}
+
+void PVCompressPlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVCompressPluginPtr pvPlugin = PVCompressPluginPtr(new PVCompressPlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVCompressPlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVCompressFilter::create(requestValue,master);
+}
+
+FieldConstPtr PVCompressPlugin::getCopyField(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    if(!PVCompressFilter::create(requestValue,master)) return FieldConstPtr();
+    return getFieldCreate()->createScalarArray(pvUByte);
+}
+
+PVScalarArrayPtr PVCompressPlugin::decode(shared_vector<const uint8> const & encoded)
+{
+    if(encoded.size()<headerLength || encoded[0]!=codecDelta) return PVScalarArrayPtr();
+    const uint8 * in = encoded.data();
+    const uint8 * end = in + encoded.size();
+    ScalarType type = static_cast<ScalarType>(in[1]);
+    size_t n = 0;
+    for(int i=0; i<4; ++i) n |= static_cast<size_t>(in[4 + i]) << (8*i);
+    in += headerLength;
+    // every block has at least its width
+    if(static_cast<size_t>(end - in)<(n + blockLength - 1)/blockLength) return PVScalarArrayPtr();
+    switch(type) {
+    case pvByte:    return decodeArray<int8>(in,end,n,type);
+    case pvShort:   return decodeArray<int16>(in,end,n,type);
+    case pvInt:     return decodeArray<int32>(in,end,n,type);
+    case pvLong:    return decodeArray<int64>(in,end,n,type);
+    case pvUByte:   return decodeArray<uint8>(in,end,n,type);
+    case pvUShort:  return decodeArray<uint16>(in,end,n,type);
+    case pvUInt:    return decodeArray<uint32>(in,end,n,type);
+    case pvULong:   return decodeArray<uint64>(in,end,n,type);
+    default: break;
+    }
+    return PVScalarArrayPtr();
+}
+
+PVCompressFilter::~PVCompressFilter()
+{
+}
+
+PVCompressFilterPtr PVCompressFilter::create(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    if(requestValue!="delta") return PVCompressFilterPtr();
+    FieldConstPtr field = master->getField();
+    if(field->getType()!=scalarArray) return PVCompressFilterPtr();
+    ScalarType type = static_pointer_cast<const ScalarArray>(field)->getElementType();
+    if(!ScalarTypeFunc::isInteger(type) && !ScalarTypeFunc::isUInteger(type)) {
+        return PVCompressFilterPtr();
+    }
+    PVCompressFilterPtr filter = PVCompressFilterPtr(
+        new PVCompressFilter(static_pointer_cast<PVScalarArray>(master)));
+    return filter;
+}
+
+PVCompressFilter::PVCompressFilter(const PVScalarArrayPtr & masterArray)
+: masterArray(masterArray)
+{
+}
+
+bool PVCompressFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    // the copy has another type, it is never put into the master
+    if(!toCopy) return true;
+    PVScalarArray & copyArray = static_cast<PVScalarArray &>(*pvCopy);
+    ScalarType type = masterArray->getScalarArray()->getElementType();
+    switch(type) {
+    case pvByte:    encodeArray<int8>(*masterArray,type,copyArray); break;
+    case pvShort:   encodeArray<int16>(*masterArray,type,copyArray); break;
+    case pvInt:     encodeArray<int32>(*masterArray,type,copyArray); break;
+    case pvLong:    encodeArray<int64>(*masterArray,type,copyArray); break;
+    case pvUByte:   encodeArray<uint8>(*masterArray,type,copyArray); break;
+    case pvUShort:  encodeArray<uint16>(*masterArray,type,copyArray); break;
+    case pvUInt:    encodeArray<uint32>(*masterArray,type,copyArray); break;
+    case pvULong:   encodeArray<uint64>(*masterArray,type,copyArray); break;
+    default: break;
+    }
+    bitSet->set(pvCopy->getFieldOffset());
+    return true;
+}
+
+string PVCompressFilter::getName()
+{
+    return name;
+}
+
+}}
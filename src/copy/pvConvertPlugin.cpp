@@ -0,0 +1,218 @@
+/* pvConvertPlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <stdlib.h>
+#include <cmath>
+#include <limits>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvConvertPlugin.h"
+
+using std::string;
+using std::size_t;
+using std::tr1::static_pointer_cast;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("convert");
+
+PVConvertPlugin::PVConvertPlugin()
+{
+}
+
+PVConvertPlugin::~PVConvertPlugin()
+{
+}
+
+void PVConvertPlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVConvertPluginPtr pvPlugin = PVConvertPluginPtr(new PVConvertPlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVConvertPlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVConvertFilter::create(requestValue,master);
+}
+
+FieldConstPtr PVConvertPlugin::getCopyField(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    ScalarType elementType = pvDouble;
+    double scale = 1.0;
+    double offset = 0.0;
+    if(!PVConvertFilter::parse(requestValue,master,elementType,scale,offset)) {
+        return FieldConstPtr();
+    }
+    return getFieldCreate()->createScalarArray(elementType);
+}
+
+PVConvertFilter::~PVConvertFilter()
+{
+}
+
+bool PVConvertFilter::parse(
+     const std::string & requestValue,
+     const PVFieldPtr & master,
+     ScalarType & elementType,
+     double & scale,
+     double & offset)
+{
+    FieldConstPtr field = master->getField();
+    if(field->getType()!=scalarArray) return false;
+    ScalarType masterType = static_pointer_cast<const ScalarArray>(field)->getElementType();
+    if(!ScalarTypeFunc::isNumeric(masterType)) return false;
+    string::size_type pos = requestValue.find(':');
+    string typeName = requestValue.substr(0,pos);
+    // 64 bit integers are no smaller than the master
+    bool found = false;
+    for(int type=pvByte; type<=pvDouble; ++type) {
+        if(type==pvLong || type==pvULong) continue;
+        if(typeName!=ScalarTypeFunc::name(static_cast<ScalarType>(type))) continue;
+        elementType = static_cast<ScalarType>(type);
+        found = true;
+    }
+    if(!found) return false;
+    scale = 1.0;
+    offset = 0.0;
+    if(pos==string::npos) return true;
+    string::size_type next = requestValue.find(':',pos+1);
+    string value = requestValue.substr(pos+1,next==string::npos ? string::npos : next-pos-1);
+    char * end = 0;
+    scale = strtod(value.c_str(),&end);
+    if(value.empty() || *end!=0 || scale==0.0 || scale!=scale) return false;
+    if(next==string::npos) return true;
+    value = requestValue.substr(next+1);
+    offset = strtod(value.c_str(),&end);
+    if(value.empty() || *end!=0 || offset!=offset) return false;
+    return true;
+}
+
+PVConvertFilterPtr PVConvertFilter::create(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    ScalarType elementType = pvDouble;
+    double scale = 1.0;
+    double offset = 0.0;
+    if(!parse(requestValue,master,elementType,scale,offset)) return PVConvertFilterPtr();
+    PVConvertFilterPtr filter = PVConvertFilterPtr(
+        new PVConvertFilter(elementType,scale,offset,static_pointer_cast<PVScalarArray>(master)));
+    return filter;
+}
+
+PVConvertFilter::PVConvertFilter(
+    ScalarType elementType,double scale,double offset,
+    const PVScalarArrayPtr & masterArray)
+: elementType(elementType),
+  scale(scale),
+  offset(offset),
+  masterArray(masterArray)
+{
+}
+
+// Converts n elements to (from - offset)/scale.
+// The loops have no branches, so the compiler can vectorize them.
+// For an integer type fmax, fmin and copysign clip and round without a compare,
+// a compare that selects would be a branch without -fno-trapping-math.
+template<typename S,typename D>
+static void convertElements(const S * from,size_t n,double scale,double offset,D * to)
+{
+    double factor = 1.0/scale;
+    if(!std::numeric_limits<D>::is_integer) {
+        if(scale==1.0 && offset==0.0) {
+            for(size_t i=0; i<n; ++i) to[i] = static_cast<D>(from[i]);
+            return;
+        }
+        for(size_t i=0; i<n; ++i) to[i] = static_cast<D>((from[i] - offset)*factor);
+        return;
+    }
+    const double low = static_cast<double>(std::numeric_limits<D>::min());
+    const double high = static_cast<double>(std::numeric_limits<D>::max());
+    for(size_t i=0; i<n; ++i) {
+        // a NaN becomes low
+        double value = fmin(fmax((from[i] - offset)*factor,low),high);
+        to[i] = static_cast<D>(value + copysign(0.5,value));
+    }
+}
+
+template<typename S,typename D>
+static void putConverted(
+    typename PVValueArray<S>::const_svector const & from,double scale,double offset,
+    PVScalarArray & copyArray)
+{
+    PVValueArray<D> & to = static_cast<PVValueArray<D> &>(copyArray);
+    typename PVValueArray<D>::const_svector current;
+    to.swap(current);
+    typename PVValueArray<D>::svector values;
+    if(current.unique()) values = thaw(current);
+    values.resize(from.size());
+    convertElements<S,D>(from.data(),from.size(),scale,offset,values.data());
+    to.replace(freeze(values));
+}
+
+#define CONVERT_CASE(TYPE, T) \
+    case TYPE: putConverted<S,T>(from,scale,offset,copyArray); break;
+
+template<typename S>
+static void convertArray(
+    PVScalarArray const & masterArray,ScalarType elementType,double scale,double offset,
+    PVScalarArray & copyArray)
+{
+    typename PVValueArray<S>::const_svector from(
+        static_cast<PVValueArray<S> const &>(masterArray).view());
+    switch(elementType) {
+    CONVERT_CASE(pvByte, int8)
+    CONVERT_CASE(pvShort, int16)
+    CONVERT_CASE(pvInt, int32)
+    CONVERT_CASE(pvUByte, uint8)
+    CONVERT_CASE(pvUShort, uint16)
+    CONVERT_CASE(pvUInt, uint32)
+    CONVERT_CASE(pvFloat, float)
+    CONVERT_CASE(pvDouble, double)
+    default: break;
+    }
+}
+
+#undef CONVERT_CASE
+
+bool PVConvertFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    // the copy has another type, it is never put into the master
+    if(!toCopy) return true;
+    PVScalarArray & copyArray = static_cast<PVScalarArray &>(*pvCopy);
+    switch(masterArray->getScalarArray()->getElementType()) {
+    case pvByte:    convertArray<int8>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvShort:   convertArray<int16>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvInt:     convertArray<int32>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvLong:    convertArray<int64>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvUByte:   convertArray<uint8>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvUShort:  convertArray<uint16>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvUInt:    convertArray<uint32>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvULong:   convertArray<uint64>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvFloat:   convertArray<float>(*masterArray,elementType,scale,offset,copyArray); break;
+    case pvDouble:  convertArray<double>(*masterArray,elementType,scale,offset,copyArray); break;
+    default: break;
+    }
+    bitSet->set(pvCopy->getFieldOffset());
+    return true;
+}
+
+string PVConvertFilter::getName()
+{
+    return name;
+}
+
+}}
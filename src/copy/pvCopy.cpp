@@ -10,6 +10,8 @@
 #include <stdexcept>
 #include <memory>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 #include <epicsThread.h>
 #include <pv/pvData.h>
@@ -47,11 +49,103 @@ static PVCopyPtr NULLPVCopy;
 static StructureConstPtr NULLStructure;
 static PVStructurePtr NULLPVStructure;
 
+/*
+ * Leaf kernels.
+ * When a node is created the exact type of a scalar or scalarArray master field is known.
+ * The kernels copy and compare such a field without the introspection dispatch
+ * that PVField::copy and operator== do on every call.
+ */
+typedef void (*LeafCopyFunc)(PVField & to,PVField const & from);
+typedef bool (*LeafEqualFunc)(PVField const & a,PVField const & b);
+typedef void (*LeafReleaseFunc)(PVField & field);
+
+template<typename T>
+struct LeafElements {
+    // integer element types have no padding and no NaN, so a byte compare is exact
+    static bool equal(T const * a,T const * b,size_t n)
+    {
+        return memcmp(a,b,n*sizeof(T))==0;
+    }
+};
+
+template<typename T>
+struct LeafFloatElements {
+    // branch free inner loop over fixed size blocks so that the compiler can vectorize it
+    static bool equal(T const * a,T const * b,size_t n)
+    {
+        const size_t blockSize = 256;
+        size_t i = 0;
+        while(i<n) {
+            size_t end = (n-i>blockSize) ? i + blockSize : n;
+            int differ = 0;
+            for(; i<end; ++i) differ |= (a[i]!=b[i]);
+            if(differ) return false;
+        }
+        return true;
+    }
+};
+
+template<> struct LeafElements<float> : public LeafFloatElements<float> {};
+template<> struct LeafElements<double> : public LeafFloatElements<double> {};
+
+template<> struct LeafElements<string> {
+    static bool equal(string const * a,string const * b,size_t n)
+    {
+        return std::equal(a,a+n,b);
+    }
+};
+
+template<typename T>
+static void copyScalarLeaf(PVField & to,PVField const & from)
+{
+    static_cast<PVScalarValue<T> &>(to).put(
+        static_cast<PVScalarValue<T> const &>(from).get());
+}
+
+template<typename T>
+static bool equalScalarLeaf(PVField const & a,PVField const & b)
+{
+    return static_cast<PVScalarValue<T> const &>(a).get()
+        == static_cast<PVScalarValue<T> const &>(b).get();
+}
+
+// The frozen buffer is shared, no element is copied.
+template<typename T>
+static void copyArrayLeaf(PVField & to,PVField const & from)
+{
+    static_cast<PVValueArray<T> &>(to).replace(
+        static_cast<PVValueArray<T> const &>(from).view());
+}
+
+// Drop the reference to the buffer without touching the elements.
+template<typename T>
+static void releaseArrayLeaf(PVField & field)
+{
+    static_cast<PVValueArray<T> &>(field).replace(
+        typename PVValueArray<T>::const_svector());
+}
+
+template<typename T>
+static bool equalArrayLeaf(PVField const & a,PVField const & b)
+{
+    typename PVValueArray<T>::const_svector va(
+        static_cast<PVValueArray<T> const &>(a).view());
+    typename PVValueArray<T>::const_svector vb(
+        static_cast<PVValueArray<T> const &>(b).view());
+    if(va.size()!=vb.size()) return false;
+    if(va.data()==vb.data()) return true;
+    return LeafElements<T>::equal(va.data(),vb.data(),va.size());
+}
+
 struct CopyNode {
     CopyNode()
     : isStructure(false),
       structureOffset(0),
-      nfields(0)
+      nfields(0),
+      isDependent(false),
+      copyLeaf(0),
+      equalLeaf(0),
+      releaseLeaf(0)
     {}
     PVFieldPtr masterPVField;
     bool isStructure;
@@ -59,10 +153,87 @@ struct CopyNode {
     size_t nfields;
     PVStructurePtr options;
     vector<PVFilterPtr> pvFilters;
+    bool isDependent; // written by a filter of another field
+    LeafCopyFunc copyLeaf;   // null unless masterPVField is a scalar or scalarArray
+    LeafEqualFunc equalLeaf;
+    LeafReleaseFunc releaseLeaf; // null unless masterPVField is a scalarArray
 };
 
+template<typename T>
+static void setScalarLeaf(CopyNode & node)
+{
+    node.copyLeaf = &copyScalarLeaf<T>;
+    node.equalLeaf = &equalScalarLeaf<T>;
+}
+
+template<typename T>
+static void setArrayLeaf(CopyNode & node)
+{
+    node.copyLeaf = &copyArrayLeaf<T>;
+    node.equalLeaf = &equalArrayLeaf<T>;
+    node.releaseLeaf = &releaseArrayLeaf<T>;
+}
+
+static void initLeafKernel(CopyNode & node)
+{
+    FieldConstPtr field = node.masterPVField->getField();
+    Type type = field->getType();
+    if(type==epics::pvData::scalar) {
+        switch(static_pointer_cast<const Scalar>(field)->getScalarType()) {
+        case pvBoolean: setScalarLeaf<boolean>(node); break;
+        case pvByte:    setScalarLeaf<int8>(node); break;
+        case pvShort:   setScalarLeaf<int16>(node); break;
+        case pvInt:     setScalarLeaf<int32>(node); break;
+        case pvLong:    setScalarLeaf<int64>(node); break;
+        case pvUByte:   setScalarLeaf<uint8>(node); break;
+        case pvUShort:  setScalarLeaf<uint16>(node); break;
+        case pvUInt:    setScalarLeaf<uint32>(node); break;
+        case pvULong:   setScalarLeaf<uint64>(node); break;
+        case pvFloat:   setScalarLeaf<float>(node); break;
+        case pvDouble:  setScalarLeaf<double>(node); break;
+        case pvString:  setScalarLeaf<string>(node); break;
+        }
+    } else if(type==epics::pvData::scalarArray) {
+        switch(static_pointer_cast<const ScalarArray>(field)->getElementType()) {
+        case pvBoolean: setArrayLeaf<boolean>(node); break;
+        case pvByte:    setArrayLeaf<int8>(node); break;
+        case pvShort:   setArrayLeaf<int16>(node); break;
+        case pvInt:     setArrayLeaf<int32>(node); break;
+        case pvLong:    setArrayLeaf<int64>(node); break;
+        case pvUByte:   setArrayLeaf<uint8>(node); break;
+        case pvUShort:  setArrayLeaf<uint16>(node); break;
+        case pvUInt:    setArrayLeaf<uint32>(node); break;
+        case pvULong:   setArrayLeaf<uint64>(node); break;
+        case pvFloat:   setArrayLeaf<float>(node); break;
+        case pvDouble:  setArrayLeaf<double>(node); break;
+        case pvString:  setArrayLeaf<string>(node); break;
+        }
+    }
+}
+
 static CopyNodePtr NULLCopyNode;
 
+// A plugin in the options of a field may give the copy another type than the master.
+static FieldConstPtr getCopyField(
+    PVFieldPtr const & pvMasterField,
+    PVFieldPtr const & pvRequestField)
+{
+    FieldConstPtr field = pvMasterField->getField();
+    if(pvRequestField->getField()->getType()!=epics::pvData::structure) return field;
+    PVStructurePtr pvOptions = static_pointer_cast<PVStructure>(pvRequestField)
+        ->getSubField<PVStructure>("_options");
+    if(!pvOptions) return field;
+    PVFieldPtrArray const & pvFields = pvOptions->getPVFields();
+    for(size_t i=0; i<pvFields.size(); ++i) {
+        PVPluginPtr pvPlugin = PVPluginRegistry::find(pvFields[i]->getFieldName());
+        if(!pvPlugin) continue;
+        PVStringPtr pvOption = static_pointer_cast<PVString>(pvFields[i]);
+        FieldConstPtr copyField = pvPlugin->getCopyField(pvOption->get(),pvMasterField);
+        if(copyField) return copyField;
+    }
+    return field;
+}
+
 typedef std::vector<CopyNodePtr> CopyNodePtrArray;
 typedef std::tr1::shared_ptr<CopyNodePtrArray> CopyNodePtrArrayPtr;
 
@@ -74,6 +245,15 @@ PVCopyPtr PVCopy::create(
     PVStructurePtr const &pvMaster,
     PVStructurePtr const &pvRequest,
     string const & structureName)
+{
+    return create(pvMaster,pvRequest,structureName,SequenceNumberConstPtr());
+}
+
+PVCopyPtr PVCopy::create(
+    PVStructurePtr const &pvMaster,
+    PVStructurePtr const &pvRequest,
+    string const & structureName,
+    SequenceNumberConstPtr const & sequenceNumber)
 {
     PVStructurePtr pvStructure(pvRequest);
     if(structureName.size()>0) {
@@ -85,6 +265,8 @@ PVCopyPtr PVCopy::create(
         pvStructure = pvRequest->getSubField<PVStructure>("field");
     }
     PVCopyPtr pvCopy = PVCopyPtr(new PVCopy(pvMaster));
+    // the filters created by init read it
+    pvCopy->sequenceNumber = sequenceNumber;
     bool result = pvCopy->init(pvStructure);
     if(!result) return PVCopyPtr();
     pvCopy->traverseMasterInitPlugin();
@@ -187,6 +369,7 @@ void PVCopy::initCopy(
         bitSet->set(i,true);
     }
     updateCopyFromBitSet(copyPVStructure,headNode,bitSet);
+    updateVolatile(copyPVStructure,bitSet);
 }
 
 
@@ -195,7 +378,11 @@ bool PVCopy::updateCopySetBitSet(
     BitSetPtr const  &bitSet)
 {
     updateCopySetBitSet(copyPVStructure,headNode,bitSet);
-    return checkIgnore(copyPVStructure,bitSet);
+    bool result = checkIgnore(copyPVStructure,bitSet);
+    // volatile fields only go with a change of the copy
+    if(result) updateVolatile(copyPVStructure,bitSet);
+    if(result && !conditionNodes.empty()) result = updateCondition(copyPVStructure,bitSet);
+    return result;
 }
 
 bool PVCopy::updateCopyFromBitSet(
@@ -208,7 +395,11 @@ bool PVCopy::updateCopyFromBitSet(
         }
     }
     updateCopyFromBitSet(copyPVStructure,headNode,bitSet);
-    return checkIgnore(copyPVStructure,bitSet);
+    bool result = checkIgnore(copyPVStructure,bitSet);
+    // volatile fields only go with a change of the copy
+    if(result) updateVolatile(copyPVStructure,bitSet);
+    if(result && !conditionNodes.empty()) result = updateCondition(copyPVStructure,bitSet);
+    return result;
 }
 
 void PVCopy::updateMasterField(
@@ -217,12 +408,18 @@ void PVCopy::updateMasterField(
      PVFieldPtr const &pvMaster,
      BitSetPtr const  &bitSet)
 {
+    if(node->isDependent) return;
     bool result = false;
     for(size_t i=0; i< node->pvFilters.size(); ++i) {
         PVFilterPtr pvFilter = node->pvFilters[i];
         if(pvFilter->filter(pvCopy,bitSet,false)) result = true;
     }
     if(result) return;
+    if(node->copyLeaf) {
+        node->copyLeaf(*pvMaster,*pvCopy);
+        if(moveArrays && node->releaseLeaf) node->releaseLeaf(*pvCopy);
+        return;
+    }
     pvMaster->copyUnchecked(*pvCopy);
 }
 
@@ -296,6 +493,12 @@ void PVCopy::updateMaster(
     }
 }
 
+void PVCopy::flush(std::size_t copyOffset)
+{
+    PVCopyFlushRequesterPtr requester = flushRequester.lock();
+    if(requester) requester->flush(copyOffset);
+}
+
 PVStructurePtr PVCopy::getOptions(std::size_t fieldOffset)
 {
     if(fieldOffset==0) return headNode->options;
@@ -371,13 +574,26 @@ void PVCopy::updateCopySetBitSet(
     CopyNodePtr const & node,
     BitSetPtr const & bitSet)
 {
+    if(node->isDependent) return;
     bool result = false;
     for(size_t i=0; i< node->pvFilters.size(); ++i) {
         PVFilterPtr pvFilter = node->pvFilters[i];
-        if(pvFilter->filter(pvCopy,bitSet,true)) result = true;
+        if(pvFilter->isCondition()) continue;
+        if(pvFilter->isVolatile()) {
+            result = true;
+        } else if(pvFilter->filter(pvCopy,bitSet,true)) {
+            result = true;
+        }
     }
     if(!node->isStructure) {
         if(result) return;
+        if(node->copyLeaf) {
+            PVField const & pvMaster = *node->masterPVField;
+            if(node->equalLeaf(*pvCopy,pvMaster)) return;
+            node->copyLeaf(*pvCopy,pvMaster);
+            bitSet->set(pvCopy->getFieldOffset());
+            return;
+        }
         updateCopySetBitSet(pvCopy,node->masterPVField,bitSet);
         return;
     }
@@ -395,17 +611,23 @@ void PVCopy::updateCopyFromBitSet(
     CopyNodePtr const & node,
     BitSetPtr const & bitSet)
 {
+    if(node->isDependent) return;
     bool result = false;
     bool update = bitSet->get(pvCopy->getFieldOffset());
     if(update) {
         for(size_t i=0; i< node->pvFilters.size(); ++i) {
             PVFilterPtr pvFilter = node->pvFilters[i];
+            if(pvFilter->isVolatile() || pvFilter->isCondition()) continue;
             if(pvFilter->filter(pvCopy,bitSet,true)) result = true;
         }
     }
     if(!node->isStructure) {
         if(result) return;
         PVFieldPtr pvMaster = node->masterPVField;
+        if(node->copyLeaf) {
+            node->copyLeaf(*pvCopy,*pvMaster);
+            return;
+        }
         pvCopy->copy(*pvMaster);
         return;
     }
@@ -421,9 +643,46 @@ void PVCopy::updateCopyFromBitSet(
     }
 }
 
+void PVCopy::updateVolatile(
+    PVStructurePtr const & copyPVStructure,
+    BitSetPtr const & bitSet)
+{
+    for(size_t i=0; i<volatileNodes.size(); ++i) {
+        CopyNodePtr const & node = volatileNodes[i];
+        PVFieldPtr pvCopy = (node->structureOffset==0)
+            ? copyPVStructure
+            : copyPVStructure->getSubField(node->structureOffset);
+        for(size_t j=0; j< node->pvFilters.size(); ++j) {
+            PVFilterPtr const & pvFilter = node->pvFilters[j];
+            if(pvFilter->isVolatile()) pvFilter->filter(pvCopy,bitSet,true);
+        }
+    }
+}
+
+bool PVCopy::updateCondition(
+    PVStructurePtr const & copyPVStructure,
+    BitSetPtr const & bitSet)
+{
+    for(size_t i=0; i<conditionNodes.size(); ++i) {
+        CopyNodePtr const & node = conditionNodes[i];
+        PVFieldPtr pvCopy = (node->structureOffset==0)
+            ? copyPVStructure
+            : copyPVStructure->getSubField(node->structureOffset);
+        for(size_t j=0; j< node->pvFilters.size(); ++j) {
+            PVFilterPtr const & pvFilter = node->pvFilters[j];
+            if(!pvFilter->isCondition()) continue;
+            pvFilter->filter(pvCopy,bitSet,true);
+            // a suppressed update is not shown to the next condition
+            if(bitSet->nextSetBit(0)<0) return false;
+        }
+    }
+    return true;
+}
+
 PVCopy::PVCopy(
     PVStructurePtr const &pvMaster)
-: pvMaster(pvMaster)
+: pvMaster(pvMaster),
+  moveArrays(false)
 {
 }
 
@@ -510,7 +769,7 @@ StructureConstPtr PVCopy::createStructure(
             }
         }
         fieldNames.push_back(fieldName);
-        fields.push_back(field);
+        fields.push_back(getCopyField(pvMasterField,pvFromRequestFields[i]));
     }
     size_t numsubfields = fields.size();
     if(numsubfields==0) {
@@ -608,6 +867,8 @@ CopyNodePtr PVCopy::createStructureNodes(
         node->masterPVField = pvMasterField;
         node->nfields = copyPVField->getNumberFields();
         node->structureOffset = copyPVField->getFieldOffset();
+        // the kernels copy between fields of the same type
+        if(*copyPVField->getField()==*pvMasterField->getField()) initLeafKernel(*node);
         nodes->push_back(node);
     }
     CopyStructureNodePtr structureNode(new CopyStructureNode());
@@ -627,6 +888,15 @@ void PVCopy::initPlugin(
 {
     PVFieldPtrArray const & pvFields = pvOptions->getPVFields();
     size_t num = pvFields.size();
+    // The other filters of a field whose copy has another type than the master
+    // would write the type of the master, only the plugin that gave the type is used.
+    size_t typed = num;
+    for(size_t i=0; i<num && typed==num; ++i) {
+        PVPluginPtr pvPlugin = PVPluginRegistry::find(pvFields[i]->getFieldName());
+        if(!pvPlugin) continue;
+        PVStringPtr pvOption = static_pointer_cast<PVString>(pvFields[i]);
+        if(pvPlugin->getCopyField(pvOption->get(),pvMasterField)) typed = i;
+    }
     vector<PVFilterPtr> pvFilters(num);
     size_t numfilter = 0;
     for(size_t i=0; i<num; ++i) {
@@ -638,12 +908,33 @@ void PVCopy::initPlugin(
             if(name.compare("ignore")==0) setIgnore(node);
             continue;
         }
+        if(typed<num && i!=typed) continue;
         pvFilters[numfilter] = pvPlugin->create(value,shared_from_this(),pvMasterField);
         if(pvFilters[numfilter]) ++numfilter;
     }
     if(numfilter==0) return;
     node->pvFilters.resize(numfilter);
-    for(size_t i=0; i<numfilter; ++i) node->pvFilters[i] = pvFilters[i];
+    bool isVolatile = false;
+    bool isCondition = false;
+    for(size_t i=0; i<numfilter; ++i) {
+        node->pvFilters[i] = pvFilters[i];
+        if(pvFilters[i]->isVolatile()) isVolatile = true;
+        if(pvFilters[i]->isCondition()) isCondition = true;
+    }
+    if(isVolatile) volatileNodes.push_back(node);
+    if(isCondition) conditionNodes.push_back(node);
+    PVStructure * pvParent = pvMasterField->getParent();
+    if(!pvParent) return;
+    for(size_t i=0; i<numfilter; ++i) {
+        vector<string> names(pvFilters[i]->getDependentFields());
+        for(size_t j=0; j<names.size(); ++j) {
+            PVFieldPtr pvDependent = pvParent->getSubField(names[j]);
+            if(!pvDependent) continue;
+            size_t offset = getCopyOffset(pvDependent);
+            if(offset==string::npos) continue;
+            getCopyNode(offset)->isDependent = true;
+        }
+    }
 }
 
 void PVCopy::traverseMasterInitPlugin()
@@ -3,13 +3,14 @@
  * The License for this software can be found in the file LICENSE that is included with the distribution.
  */
 #include <stdlib.h>
+#include <cmath>
+#include <limits>
 
 #include <string>
 #include <map>
 #include <pv/lock.h>
 #include <pv/pvData.h>
 #include <pv/bitSet.h>
-#include <pv/convert.h>
 
 #define epicsExportSharedSymbols
 #include "pv/pvDeadbandPlugin.h"
@@ -24,7 +25,6 @@ using namespace epics::pvData;
 
 namespace epics { namespace pvCopy{
 
-static ConvertPtr convert = getConvert();
 static std::string name("deadband");
 
 PVDeadbandPlugin::PVDeadbandPlugin()
@@ -63,14 +63,23 @@ PVDeadbandFilterPtr PVDeadbandFilter::create(
 {
     FieldConstPtr field =master->getField();
     Type type = field->getType();
-    if(type!=scalar) return PVDeadbandFilterPtr();
-    ScalarConstPtr scalar = static_pointer_cast<const Scalar>(field);
-    if(!ScalarTypeFunc::isNumeric(scalar->getScalarType())) return PVDeadbandFilterPtr();
+    ScalarType scalarType;
+    if(type==scalar) {
+        scalarType = static_pointer_cast<const Scalar>(field)->getScalarType();
+    } else if(type==scalarArray) {
+        scalarType = static_pointer_cast<const ScalarArray>(field)->getElementType();
+    } else {
+        return PVDeadbandFilterPtr();
+    }
+    if(!ScalarTypeFunc::isNumeric(scalarType)) return PVDeadbandFilterPtr();
     bool absolute = false;
+    bool rms = false;
     if(requestValue.find("abs")==0) {
         absolute = true;
     } else if(requestValue.find("rel")==0) {
         absolute = false;
+    } else if(requestValue.find("rms")==0 && type==scalarArray) {
+        rms = true;
     } else {
         return PVDeadbandFilterPtr();
     }
@@ -79,6 +88,13 @@ PVDeadbandFilterPtr PVDeadbandFilter::create(
     string svalue = requestValue.substr(ind+1);
     double deadband = atof(svalue.c_str());
     if(deadband==0.0) return PVDeadbandFilterPtr();
+    if(type==scalarArray) {
+        PVDeadbandFilterPtr filter =
+             PVDeadbandFilterPtr(
+                 new PVDeadbandFilter(
+                     absolute,rms,deadband,static_pointer_cast<PVScalarArray>(master)));
+        return filter;
+    }
     PVDeadbandFilterPtr filter =
          PVDeadbandFilterPtr(
              new PVDeadbandFilter(
@@ -86,44 +102,208 @@ PVDeadbandFilterPtr PVDeadbandFilter::create(
     return filter;
 }
 
+// The absolute difference of a and b, integers without overflow.
+template<typename T>
+static inline double absDiff(T a,T b)
+{
+    if(std::numeric_limits<T>::is_integer) {
+        uint64 diff = (a>b) ? uint64(a) - uint64(b) : uint64(b) - uint64(a);
+        return double(diff);
+    }
+    return (a>b) ? double(a) - double(b) : double(b) - double(a);
+}
+
+template<typename T>
+static bool reportScalar(
+    PVScalar const & master,PVField & copy,PVScalar & lastReported,
+    bool firstTime,bool absolute,double deadband)
+{
+    T value = static_cast<PVScalarValue<T> const &>(master).get();
+    static_cast<PVScalarValue<T> &>(copy).put(value);
+    PVScalarValue<T> & last = static_cast<PVScalarValue<T> &>(lastReported);
+    bool report = true;
+    if(!firstTime) {
+        T lastValue = last.get();
+        double diff = absDiff<T>(value,lastValue);
+        if(absolute) {
+            if(diff<deadband) report = false;
+        } else {
+            double magnitude = double(lastValue);
+            if(magnitude<0.0) magnitude = -magnitude;
+            if(magnitude>1e-20 && (diff/magnitude)*100.0<deadband) report = false;
+        }
+    }
+    if(report) last.put(value);
+    return report;
+}
+
 PVDeadbandFilter::PVDeadbandFilter(bool absolute,double deadband,PVScalarPtr const & master)
 : absolute(absolute),
+  rms(false),
   deadband(deadband),
   master(master),
   firstTime(true),
-  lastReportedValue(0.0)
+  reportScalar(0)
+{
+    ScalarType scalarType = master->getScalar()->getScalarType();
+    switch(scalarType) {
+    case pvByte:    reportScalar = &epics::pvCopy::reportScalar<int8>; break;
+    case pvShort:   reportScalar = &epics::pvCopy::reportScalar<int16>; break;
+    case pvInt:     reportScalar = &epics::pvCopy::reportScalar<int32>; break;
+    case pvLong:    reportScalar = &epics::pvCopy::reportScalar<int64>; break;
+    case pvUByte:   reportScalar = &epics::pvCopy::reportScalar<uint8>; break;
+    case pvUShort:  reportScalar = &epics::pvCopy::reportScalar<uint16>; break;
+    case pvUInt:    reportScalar = &epics::pvCopy::reportScalar<uint32>; break;
+    case pvULong:   reportScalar = &epics::pvCopy::reportScalar<uint64>; break;
+    case pvFloat:   reportScalar = &epics::pvCopy::reportScalar<float>; break;
+    case pvDouble:  reportScalar = &epics::pvCopy::reportScalar<double>; break;
+    default: break;
+    }
+    lastReported = getPVDataCreate()->createPVScalar(scalarType);
+}
+
+PVDeadbandFilter::PVDeadbandFilter(
+    bool absolute,bool rms,double deadband,
+    PVScalarArrayPtr const & masterArray)
+: absolute(absolute),
+  rms(rms),
+  deadband(deadband),
+  masterArray(masterArray),
+  firstTime(true),
+  reportScalar(0)
 {
 }
 
+// The kernels keep numberLanes independent partial results,
+// so the compiler can vectorize them.
+enum {numberLanes = 8};
 
-bool PVDeadbandFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+// The largest absolute difference of the elements of a and b.
+template<typename T>
+static double maxAbsChange(const T * a,const T * b,size_t n)
 {
-    if(!toCopy) return false;
-    double value = convert->toDouble(master);
-    double diff = value - lastReportedValue;
-    if(diff<0.0) diff = - diff;
+    double maxs[numberLanes] = {0.0};
+    size_t i = 0;
+    for(; i+numberLanes<=n; i+=numberLanes) {
+        for(int k=0; k<numberLanes; ++k) {
+            double diff = double(a[i+k]) - double(b[i+k]);
+            diff = diff<0.0 ? -diff : diff;
+            maxs[k] = diff>maxs[k] ? diff : maxs[k];
+        }
+    }
+    for(; i<n; ++i) {
+        double diff = double(a[i]) - double(b[i]);
+        diff = diff<0.0 ? -diff : diff;
+        maxs[0] = diff>maxs[0] ? diff : maxs[0];
+    }
+    double max = maxs[0];
+    for(int k=1; k<numberLanes; ++k) max = maxs[k]>max ? maxs[k] : max;
+    return max;
+}
+
+// The sums of the squares of the differences of a and b and of the elements of b.
+template<typename T>
+static void sumSquares(const T * a,const T * b,size_t n,double & change,double & norm)
+{
+    double changes[numberLanes] = {0.0};
+    double norms[numberLanes] = {0.0};
+    size_t i = 0;
+    for(; i+numberLanes<=n; i+=numberLanes) {
+        for(int k=0; k<numberLanes; ++k) {
+            double diff = double(a[i+k]) - double(b[i+k]);
+            changes[k] += diff*diff;
+            norms[k] += double(b[i+k])*double(b[i+k]);
+        }
+    }
+    for(; i<n; ++i) {
+        double diff = double(a[i]) - double(b[i]);
+        changes[0] += diff*diff;
+        norms[0] += double(b[i])*double(b[i]);
+    }
+    change = 0.0;
+    norm = 0.0;
+    for(int k=0; k<numberLanes; ++k) {
+        change += changes[k];
+        norm += norms[k];
+    }
+}
+
+// Is the array masterArray to be reported, compared with lastReported?
+// If so lastReported is set to it.
+template<typename T>
+static bool reportArray(
+    PVScalarArray const & masterArray,shared_vector<const void> & lastReported,
+    bool firstTime,bool absolute,bool rms,double deadband)
+{
+    typename PVValueArray<T>::const_svector value(
+        static_cast<PVValueArray<T> const &>(masterArray).view());
+    typename PVValueArray<T>::const_svector last(
+        static_shared_vector_cast<const T>(lastReported));
     bool report = true;
-    if(firstTime) {
-        firstTime = false;
+    size_t n = value.size();
+    if(firstTime || n!=last.size()) {
+        report = true;
+    } else if(value.data()==last.data()) {
+        report = false;
     } else if(absolute) {
-        if(diff<deadband) report = false;
+        report = maxAbsChange<T>(value.data(),last.data(),n)>=deadband;
     } else {
-        double last = lastReportedValue;
-        if(last<0.0) last = -last;
-        if(last>1e-20) {
-            double percent = (diff/last)*100.0;
-            if(percent<deadband) report = false;
-         }
-     }
-     PVScalarPtr copy = static_pointer_cast<PVScalar>(pvCopy);
-     convert->fromDouble(copy,value);
-     if(report) {
-         lastReportedValue = value;
-         bitSet->set(pvCopy->getFieldOffset());
-     } else {
-         bitSet->clear(pvCopy->getFieldOffset());
-     }
-     return true;
+        double change = 0.0;
+        double norm = 0.0;
+        sumSquares<T>(value.data(),last.data(),n,change,norm);
+        if(rms) {
+            report = n>0 && std::sqrt(change/n)>=deadband;
+        } else {
+            report = norm<1e-40 || std::sqrt(change/norm)*100.0>=deadband;
+        }
+    }
+    if(report) lastReported = static_shared_vector_cast<const void>(value);
+    return report;
+}
+
+bool PVDeadbandFilter::filterArray(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet)
+{
+    bool report = true;
+    switch(masterArray->getScalarArray()->getElementType()) {
+#define DEADBAND_CASE(PVTYPE,T) \
+    case PVTYPE: \
+        report = reportArray<T>(*masterArray,lastReportedArray,firstTime,absolute,rms,deadband); \
+        break;
+    DEADBAND_CASE(pvByte,int8)
+    DEADBAND_CASE(pvShort,int16)
+    DEADBAND_CASE(pvInt,int32)
+    DEADBAND_CASE(pvLong,int64)
+    DEADBAND_CASE(pvUByte,uint8)
+    DEADBAND_CASE(pvUShort,uint16)
+    DEADBAND_CASE(pvUInt,uint32)
+    DEADBAND_CASE(pvULong,uint64)
+    DEADBAND_CASE(pvFloat,float)
+    DEADBAND_CASE(pvDouble,double)
+#undef DEADBAND_CASE
+    default: break;
+    }
+    firstTime = false;
+    pvCopy->copyUnchecked(*masterArray);
+    if(report) {
+        bitSet->set(pvCopy->getFieldOffset());
+    } else {
+        bitSet->clear(pvCopy->getFieldOffset());
+    }
+    return true;
+}
+
+bool PVDeadbandFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    if(!toCopy) return false;
+    if(masterArray) return filterArray(pvCopy,bitSet);
+    bool report = reportScalar(*master,*pvCopy,*lastReported,firstTime,absolute,deadband);
+    firstTime = false;
+    if(report) {
+        bitSet->set(pvCopy->getFieldOffset());
+    } else {
+        bitSet->clear(pvCopy->getFieldOffset());
+    }
+    return true;
 }
 
 string PVDeadbandFilter::getName()
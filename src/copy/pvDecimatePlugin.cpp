@@ -0,0 +1,98 @@
+/* pvDecimatePlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <stdlib.h>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvDecimatePlugin.h"
+
+using std::string;
+using std::size_t;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("decimate");
+
+PVDecimatePlugin::PVDecimatePlugin()
+{
+}
+
+PVDecimatePlugin::~PVDecimatePlugin()
+{
+}
+
+void PVDecimatePlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVDecimatePluginPtr pvPlugin = PVDecimatePluginPtr(new PVDecimatePlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVDecimatePlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVDecimateFilter::create(requestValue,master);
+}
+
+PVDecimateFilter::~PVDecimateFilter()
+{
+}
+
+PVDecimateFilterPtr PVDecimateFilter::create(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    // a structure field has the bits of its subfields
+    if(master->getField()->getType()==structure) return PVDecimateFilterPtr();
+    char * end = 0;
+    unsigned long factor = strtoul(requestValue.c_str(),&end,10);
+    if(requestValue.empty() || requestValue[0]=='-' || *end!=0) return PVDecimateFilterPtr();
+    if(factor<1 || factor>0xffffffffUL) return PVDecimateFilterPtr();
+    PVDecimateFilterPtr filter = PVDecimateFilterPtr(
+        new PVDecimateFilter(static_cast<epicsUInt32>(factor)));
+    return filter;
+}
+
+PVDecimateFilter::PVDecimateFilter(epicsUInt32 factor)
+: factor(factor),
+  count(0)
+{
+}
+
+bool PVDecimateFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    if(!toCopy) return false;
+    // only a change of the field is counted
+    if(bitSet->get(pvCopy->getFieldOffset())) {
+        if(count==0) {
+            if(factor>1) count = 1;
+            if(held.nextSetBit(0)>=0) {
+                *bitSet |= held;
+                held.clear();
+            }
+            return false;
+        }
+        if(++count>=factor) count = 0;
+    }
+    // the other changes go with the next reported change of the field
+    held |= *bitSet;
+    bitSet->clear();
+    return true;
+}
+
+string PVDecimateFilter::getName()
+{
+    return name;
+}
+
+}}
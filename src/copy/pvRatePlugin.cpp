@@ -0,0 +1,154 @@
+/* pvRatePlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <stdlib.h>
+#include <epicsTime.h>
+#include <epicsExit.h>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/timer.h>
+#define epicsExportSharedSymbols
+#include "pv/pvStructureCopy.h"
+#include "pv/pvRatePlugin.h"
+
+using std::string;
+using std::size_t;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("rate");
+
+// one timer thread for the trailing updates of all rate filters
+static TimerPtr rateTimer;
+static Mutex rateTimerMutex;
+
+static void rateTimerExit(void *)
+{
+    TimerPtr timer;
+    {
+        Lock xx(rateTimerMutex);
+        timer = rateTimer;
+    }
+    if(timer) timer->close();
+}
+
+PVRatePlugin::PVRatePlugin()
+{
+}
+
+PVRatePlugin::~PVRatePlugin()
+{
+}
+
+void PVRatePlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVRatePluginPtr pvPlugin = PVRatePluginPtr(new PVRatePlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVRatePlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVRateFilter::create(requestValue,pvCopy,master);
+}
+
+PVRateFilter::~PVRateFilter()
+{
+}
+
+PVRateFilterPtr PVRateFilter::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    // a structure field has the bits of its subfields
+    if(master->getField()->getType()==structure) return PVRateFilterPtr();
+    char * end = 0;
+    double rate = strtod(requestValue.c_str(),&end);
+    if(requestValue.empty() || *end!=0 || !(rate>0.0)) return PVRateFilterPtr();
+    {
+        Lock xx(rateTimerMutex);
+        if(!rateTimer) {
+            rateTimer = TimerPtr(new Timer("pvCopyRate",lowPriority));
+            epicsAtExit(rateTimerExit,0);
+        }
+    }
+    PVRateFilterPtr filter = PVRateFilterPtr(
+        new PVRateFilter(1.0/rate,pvCopy,master));
+    return filter;
+}
+
+PVRateFilter::PVRateFilter(
+    double interval,
+    PVCopyPtr const & pvCopy,
+    PVFieldPtr const & master)
+: interval(static_cast<epicsUInt64>(interval*1e9)),
+  master(master),
+  pvCopy(pvCopy),
+  firstTime(true),
+  lastReported(0),
+  pending(false),
+  scheduled(false),
+  copyOffset(0)
+{
+}
+
+bool PVRateFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    if(!toCopy) return false;
+    size_t offset = pvCopy->getFieldOffset();
+    epicsUInt64 now = epicsMonotonicGet();
+    Lock xx(mutex);
+    if(firstTime || now - lastReported>=interval) {
+        firstTime = false;
+        lastReported = now;
+        pending = false;
+        pvCopy->copyUnchecked(*master);
+        bitSet->set(offset);
+        return true;
+    }
+    // the copy is not touched, the flush copies the value master has then
+    bitSet->clear(offset);
+    pending = true;
+    copyOffset = offset;
+    if(!scheduled) {
+        scheduled = true;
+        double delay = (interval - (now - lastReported))*1e-9;
+        rateTimer->scheduleAfterDelay(shared_from_this(),delay);
+    }
+    return true;
+}
+
+void PVRateFilter::callback()
+{
+    size_t offset = 0;
+    {
+        Lock xx(mutex);
+        scheduled = false;
+        if(!pending) return;
+        offset = copyOffset;
+    }
+    PVCopyPtr copy = pvCopy.lock();
+    if(copy) copy->flush(offset);
+}
+
+void PVRateFilter::timerStopped()
+{
+}
+
+string PVRateFilter::getName()
+{
+    return name;
+}
+
+}}
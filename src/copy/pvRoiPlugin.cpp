@@ -0,0 +1,351 @@
+/* pvRoiPlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include <limits>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvRoiPlugin.h"
+
+using std::string;
+using std::size_t;
+using std::vector;
+using std::tr1::static_pointer_cast;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("roi");
+static std::string dimensionName("dimension");
+
+// the largest binX and binY, so that the sums of 16 bit images fit an int32
+static const size_t maxBinning = 64;
+
+PVRoiPlugin::PVRoiPlugin()
+{
+}
+
+PVRoiPlugin::~PVRoiPlugin()
+{
+}
+
+void PVRoiPlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVRoiPluginPtr pvPlugin = PVRoiPluginPtr(new PVRoiPlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVRoiPlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVRoiFilter::create(requestValue,master);
+}
+
+PVRoiFilter::~PVRoiFilter()
+{
+}
+
+PVRoiFilterPtr PVRoiFilter::create(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    if(master->getField()->getType()!=union_) return PVRoiFilterPtr();
+    // the copy of a variant union has no members to select
+    if(static_pointer_cast<PVUnion>(master)->getUnion()->isVariant()) return PVRoiFilterPtr();
+    PVStructure * pvParent = master->getParent();
+    if(!pvParent) return PVRoiFilterPtr();
+    PVStructureArrayPtr masterDimension = pvParent->getSubField<PVStructureArray>(dimensionName);
+    if(!masterDimension) return PVRoiFilterPtr();
+    // x:y:width:height[:binX:binY]
+    vector<size_t> region;
+    string::size_type index = 0;
+    while(true) {
+        string::size_type pos = requestValue.find(':',index);
+        string value = requestValue.substr(index,pos-index);
+        char * end = 0;
+        long number = strtol(value.c_str(),&end,10);
+        if(value.empty() || *end!=0 || number<0) return PVRoiFilterPtr();
+        region.push_back(number);
+        if(pos==string::npos) break;
+        index = pos + 1;
+    }
+    if(region.size()==4) {
+        region.push_back(1);
+        region.push_back(1);
+    }
+    if(region.size()!=6) return PVRoiFilterPtr();
+    for(size_t i=4; i<6; ++i) {
+        if(region[i]<1 || region[i]>maxBinning) return PVRoiFilterPtr();
+    }
+    PVRoiFilterPtr filter = PVRoiFilterPtr(
+        new PVRoiFilter(region,static_pointer_cast<PVUnion>(master),masterDimension));
+    return filter;
+}
+
+PVRoiFilter::PVRoiFilter(
+    vector<size_t> const & region,
+    PVUnionPtr const & masterValue,
+    PVStructureArrayPtr const & masterDimension)
+: x(region[0]),
+  y(region[1]),
+  width(region[2]),
+  height(region[3]),
+  binX(region[4]),
+  binY(region[5]),
+  masterValue(masterValue),
+  masterDimension(masterDimension)
+{
+}
+
+// The type in which the elements of a bin are summed.
+// Sums of the small integer types are exact and vectorize in int32 or int64.
+template<typename T,bool isInteger = std::numeric_limits<T>::is_integer,size_t size = sizeof(T)>
+struct BinSum {typedef double type;};
+template<typename T> struct BinSum<T,true,1> {typedef int32 type;};
+template<typename T> struct BinSum<T,true,2> {typedef int32 type;};
+template<typename T> struct BinSum<T,true,4> {typedef int64 type;};
+
+// Stores the means of n sums of count elements.
+template<typename T,typename Sum,bool isUnsigned>
+struct BinMean
+{
+    static void store(const Sum * sum,size_t n,size_t count,T * to)
+    {
+        double scale = 1.0/count;
+        for(size_t i=0; i<n; ++i) to[i] = static_cast<T>(sum[i]*scale);
+    }
+};
+
+// the mean of unsigned integers is a shift if count is a power of two
+template<typename T,typename Sum>
+struct BinMean<T,Sum,true>
+{
+    static void store(const Sum * sum,size_t n,size_t count,T * to)
+    {
+        if((count&(count-1))!=0) {
+            BinMean<T,Sum,false>::store(sum,n,count,to);
+            return;
+        }
+        int shift = 0;
+        while((size_t(1)<<shift)<count) ++shift;
+        for(size_t i=0; i<n; ++i) to[i] = static_cast<T>(sum[i]>>shift);
+    }
+};
+
+// Bins outY rows of outX elements of a region whose rows are nx apart.
+// For each row of the copy the rows of a bin are added two at a time into sums
+// that stay in cache, then binX adjacent sums are added.
+template<typename T>
+static void binImage(
+    const T * in,size_t nx,size_t outX,size_t outY,size_t binX,size_t binY,T * out)
+{
+    typedef typename BinSum<T>::type Sum;
+    static const bool isUnsigned = std::numeric_limits<T>::is_integer
+        && !std::numeric_limits<T>::is_signed && sizeof(T)<=4;
+    size_t n = outX*binX;
+    vector<Sum> sums(n);
+    vector<Sum> binSums(binX>1 ? outX : 0);
+    Sum * sum = &sums[0];
+    for(size_t j=0; j<outY; ++j) {
+        const T * row = in + j*binY*nx;
+        size_t r = 1;
+        if(binY%2==0) {
+            const T * next = row + nx;
+            for(size_t i=0; i<n; ++i) sum[i] = Sum(row[i]) + Sum(next[i]);
+            r = 2;
+        } else {
+            for(size_t i=0; i<n; ++i) sum[i] = row[i];
+        }
+        for(; r<binY; r+=2) {
+            const T * a = row + r*nx;
+            const T * b = a + nx;
+            for(size_t i=0; i<n; ++i) sum[i] += Sum(a[i]) + Sum(b[i]);
+        }
+        const Sum * rowSum = sum;
+        if(binX==2) {
+            for(size_t i=0; i<outX; ++i) binSums[i] = sum[2*i] + sum[2*i+1];
+            rowSum = &binSums[0];
+        } else if(binX>2) {
+            for(size_t i=0; i<outX; ++i) {
+                const Sum * bin = sum + i*binX;
+                Sum binSum = bin[0];
+                for(size_t k=1; k<binX; ++k) binSum += bin[k];
+                binSums[i] = binSum;
+            }
+            rowSum = &binSums[0];
+        }
+        BinMean<T,Sum,isUnsigned>::store(rowSum,outX,binX*binY,out + j*outX);
+    }
+}
+
+template<typename T>
+static void roiArray(
+    PVScalarArray const & masterArray,size_t nx,size_t const first[2],size_t const size[2],
+    size_t binX,size_t binY,PVScalarArray & copyArray)
+{
+    typename PVValueArray<T>::const_svector from(
+        static_cast<PVValueArray<T> const &>(masterArray).view());
+    PVValueArray<T> & to = static_cast<PVValueArray<T> &>(copyArray);
+    size_t outX = size[0]/binX;
+    size_t outY = size[1]/binY;
+    if(outX==0 || outY==0) {
+        // the region is smaller than one bin
+        to.replace(typename PVValueArray<T>::const_svector());
+        return;
+    }
+    if(binX==1 && binY==1 && outX==nx && outY*nx==from.size()) {
+        // the region is the image, the buffer is shared
+        to.replace(from);
+        return;
+    }
+    typename PVValueArray<T>::const_svector current;
+    to.swap(current);
+    typename PVValueArray<T>::svector values;
+    if(current.unique()) values = thaw(current);
+    values.resize(outX*outY);
+    const T * in = from.data() + first[1]*nx + first[0];
+    T * out = values.data();
+    if(binX==1 && binY==1) {
+        for(size_t j=0; j<outY; ++j) std::copy(in + j*nx,in + j*nx + outX,out + j*outX);
+    } else {
+        binImage<T>(in,nx,outX,outY,binX,binY,out);
+    }
+    to.replace(freeze(values));
+}
+
+static int32 getInt(PVStructurePtr const & pvStructure,string const & fieldName,int32 defaultValue)
+{
+    PVIntPtr pvInt = pvStructure->getSubField<PVInt>(fieldName);
+    return pvInt ? pvInt->get() : defaultValue;
+}
+
+static void putInt(PVStructurePtr const & pvStructure,string const & fieldName,int32 value)
+{
+    PVIntPtr pvInt = pvStructure->getSubField<PVInt>(fieldName);
+    if(pvInt) pvInt->put(value);
+}
+
+bool PVRoiFilter::putDimension(
+    PVStructureArray & copyDimension,size_t const first[2],size_t const size[2])
+{
+    PVStructureArray::const_svector masterDims(masterDimension->view());
+    PVStructureArray::const_svector copyDims(copyDimension.view());
+    size_t bin[2] = {binX,binY};
+    int32 want[2][3];
+    bool same = copyDims.size()==2;
+    for(size_t i=0; i<2; ++i) {
+        int32 masterBinning = getInt(masterDims[i],"binning",1);
+        want[i][0] = static_cast<int32>(size[i]/bin[i]);
+        want[i][1] = getInt(masterDims[i],"offset",0) + static_cast<int32>(first[i])*masterBinning;
+        want[i][2] = masterBinning*static_cast<int32>(bin[i]);
+        if(!same || !copyDims[i]) {
+            same = false;
+            continue;
+        }
+        if(getInt(copyDims[i],"size",-1)!=want[i][0]
+        || getInt(copyDims[i],"offset",-1)!=want[i][1]
+        || getInt(copyDims[i],"binning",-1)!=want[i][2]
+        || getInt(copyDims[i],"fullSize",-1)!=getInt(masterDims[i],"fullSize",-1)) {
+            same = false;
+        }
+    }
+    if(same) return false;
+    // elements may be shared with queued copies, so new ones are created
+    PVStructureArray::svector dims(2);
+    for(size_t i=0; i<2; ++i) {
+        dims[i] = getPVDataCreate()->createPVStructure(masterDims[i]);
+        putInt(dims[i],"size",want[i][0]);
+        putInt(dims[i],"offset",want[i][1]);
+        putInt(dims[i],"binning",want[i][2]);
+    }
+    copyDimension.replace(freeze(dims));
+    return true;
+}
+
+#define ROI_CASE(TYPE, T) \
+    case TYPE: roiArray<T>(masterArray,nx,first,size,binX,binY,copyArray); break;
+
+bool PVRoiFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    // the region can not be put back into the master
+    if(!toCopy) return true;
+    PVUnion & copyValue = static_cast<PVUnion &>(*pvCopy);
+    PVStructureArrayPtr copyDimension;
+    PVStructure * pvParent = pvCopy->getParent();
+    if(pvParent) copyDimension = pvParent->getSubField<PVStructureArray>(dimensionName);
+    PVFieldPtr pvValue = masterValue->get();
+    PVStructureArray::const_svector dims(masterDimension->view());
+    size_t nx = 0;
+    size_t ny = 0;
+    bool isImage = pvValue && pvValue->getField()->getType()==scalarArray
+        && dims.size()==2 && dims[0] && dims[1];
+    if(isImage) {
+        ScalarType elementType = static_pointer_cast<const ScalarArray>(
+            pvValue->getField())->getElementType();
+        int32 sizeX = getInt(dims[0],"size",0);
+        int32 sizeY = getInt(dims[1],"size",0);
+        isImage = ScalarTypeFunc::isNumeric(elementType) && sizeX>0 && sizeY>0;
+        nx = sizeX;
+        ny = sizeY;
+        isImage = isImage && nx*ny==static_cast<PVScalarArray &>(*pvValue).getLength();
+    }
+    if(!isImage) {
+        copyValue.copy(*masterValue);
+        bitSet->set(pvCopy->getFieldOffset());
+        if(copyDimension) {
+            copyDimension->copy(*masterDimension);
+            bitSet->set(copyDimension->getFieldOffset());
+        }
+        return true;
+    }
+    size_t first[2] = {std::min(x,nx),std::min(y,ny)};
+    size_t size[2] = {nx - first[0],ny - first[1]};
+    if(width>0 && width<size[0]) size[0] = width;
+    if(height>0 && height<size[1]) size[1] = height;
+    int32 index = masterValue->getSelectedIndex();
+    if(copyValue.getSelectedIndex()!=index) copyValue.select(index);
+    PVScalarArray const & masterArray = static_cast<PVScalarArray const &>(*pvValue);
+    PVScalarArray & copyArray = static_cast<PVScalarArray &>(*copyValue.get());
+    switch(masterArray.getScalarArray()->getElementType()) {
+    ROI_CASE(pvByte, int8)
+    ROI_CASE(pvShort, int16)
+    ROI_CASE(pvInt, int32)
+    ROI_CASE(pvLong, int64)
+    ROI_CASE(pvUByte, uint8)
+    ROI_CASE(pvUShort, uint16)
+    ROI_CASE(pvUInt, uint32)
+    ROI_CASE(pvULong, uint64)
+    ROI_CASE(pvFloat, float)
+    ROI_CASE(pvDouble, double)
+    default: break;
+    }
+    bitSet->set(pvCopy->getFieldOffset());
+    if(copyDimension && putDimension(*copyDimension,first,size)) {
+        bitSet->set(copyDimension->getFieldOffset());
+    }
+    return true;
+}
+
+#undef ROI_CASE
+
+string PVRoiFilter::getName()
+{
+    return name;
+}
+
+vector<string> PVRoiFilter::getDependentFields()
+{
+    return vector<string>(1,dimensionName);
+}
+
+}}
@@ -0,0 +1,96 @@
+/* pvSequencePlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvPlugin.h"
+#include "pv/pvStructureCopy.h"
+#include "pv/pvSequencePlugin.h"
+
+
+using std::string;
+using std::size_t;
+using std::tr1::static_pointer_cast;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("sequence");
+
+PVSequencePlugin::PVSequencePlugin()
+{
+}
+
+PVSequencePlugin::~PVSequencePlugin()
+{
+}
+
+void PVSequencePlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVSequencePluginPtr pvPlugin = PVSequencePluginPtr(new PVSequencePlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+     }
+}
+
+PVFilterPtr PVSequencePlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVSequenceFilter::create(requestValue,pvCopy,master);
+}
+
+PVSequenceFilter::~PVSequenceFilter()
+{
+}
+
+PVSequenceFilterPtr PVSequenceFilter::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    if(requestValue.compare("true")!=0) return PVSequenceFilterPtr();
+    FieldConstPtr field = master->getField();
+    if(field->getType()!=scalar) return PVSequenceFilterPtr();
+    ScalarType scalarType = static_pointer_cast<const Scalar>(field)->getScalarType();
+    if(!ScalarTypeFunc::isInteger(scalarType)
+    && !ScalarTypeFunc::isUInteger(scalarType)) return PVSequenceFilterPtr();
+    SequenceNumberConstPtr sequenceNumber = pvCopy->getSequenceNumber();
+    if(!sequenceNumber) return PVSequenceFilterPtr();
+    PVSequenceFilterPtr filter = PVSequenceFilterPtr(
+             new PVSequenceFilter(sequenceNumber));
+    return filter;
+}
+
+PVSequenceFilter::PVSequenceFilter(SequenceNumberConstPtr const & sequenceNumber)
+: sequenceNumber(sequenceNumber)
+{
+}
+
+
+bool PVSequenceFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    if(!toCopy) return true;
+    PVScalar * pvScalar = static_cast<PVScalar *>(pvCopy.get());
+    uint64 value = *sequenceNumber;
+    if(pvScalar->getAs<uint64>()==value) return true;
+    pvScalar->putFrom<uint64>(value);
+    bitSet->set(pvCopy->getFieldOffset());
+    return true;
+}
+
+string PVSequenceFilter::getName()
+{
+    return name;
+}
+
+}}
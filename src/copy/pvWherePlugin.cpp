@@ -0,0 +1,425 @@
+/* pvWherePlugin.cpp */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <functional>
+#include <limits>
+#include <epicsStdlib.h>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#define epicsExportSharedSymbols
+#include "pv/pvWherePlugin.h"
+
+using std::string;
+using std::size_t;
+using std::tr1::static_pointer_cast;
+using namespace epics::pvData;
+
+namespace epics { namespace pvCopy{
+
+static std::string name("where");
+
+// A node of a compiled expression.
+class WhereExpression
+{
+public:
+    virtual ~WhereExpression() {}
+    virtual bool test() const = 0;
+};
+
+namespace {
+
+// Any signed or unsigned 64 bit integer.
+// A negative value is kept as the bits of its int64, so values of
+// the same sign are ordered as their bits.
+struct WhereInteger
+{
+    bool negative;
+    uint64 bits;
+    explicit WhereInteger(int64 value) : negative(value<0),bits(static_cast<uint64>(value)) {}
+    explicit WhereInteger(uint64 value) : negative(false),bits(value) {}
+};
+
+// Returns -1, 0 or 1 if a is less than, equal to or greater than b.
+static int compareIntegers(WhereInteger const & a,WhereInteger const & b)
+{
+    if(a.negative!=b.negative) return a.negative ? -1 : 1;
+    if(a.bits==b.bits) return 0;
+    return a.bits<b.bits ? -1 : 1;
+}
+
+// An operand of a comparison, a field of the master or a constant.
+// getInteger is only called if isInteger is true.
+class WhereOperand
+{
+public:
+    virtual ~WhereOperand() {}
+    virtual bool isInteger() const = 0;
+    virtual double get() const = 0;
+    virtual WhereInteger getInteger() const = 0;
+};
+typedef std::tr1::shared_ptr<WhereOperand> WhereOperandPtr;
+
+class WhereConstant : public WhereOperand
+{
+    double value;
+public:
+    explicit WhereConstant(double value) : value(value) {}
+    virtual bool isInteger() const {return false;}
+    virtual double get() const {return value;}
+    virtual WhereInteger getInteger() const {return WhereInteger(static_cast<int64>(value));}
+};
+
+class WhereIntegerConstant : public WhereOperand
+{
+    WhereInteger value;
+public:
+    explicit WhereIntegerConstant(WhereInteger const & value) : value(value) {}
+    virtual bool isInteger() const {return true;}
+    virtual double get() const
+    {
+        return value.negative ? static_cast<double>(static_cast<int64>(value.bits))
+                              : static_cast<double>(value.bits);
+    }
+    virtual WhereInteger getInteger() const {return value;}
+};
+
+// reads the field in its own type, without Convert
+template<typename T>
+class WhereField : public WhereOperand
+{
+    std::tr1::shared_ptr<PVScalarValue<T> > pvField;
+public:
+    explicit WhereField(std::tr1::shared_ptr<PVScalarValue<T> > const & pvField)
+    : pvField(pvField) {}
+    virtual bool isInteger() const {return std::numeric_limits<T>::is_integer;}
+    virtual double get() const {return static_cast<double>(pvField->get());}
+    virtual WhereInteger getInteger() const
+    {
+        T value = pvField->get();
+        if(std::numeric_limits<T>::is_signed) return WhereInteger(static_cast<int64>(value));
+        return WhereInteger(static_cast<uint64>(value));
+    }
+};
+
+template<typename Compare>
+class WhereCompare : public WhereExpression
+{
+    WhereOperandPtr left;
+    WhereOperandPtr right;
+public:
+    WhereCompare(WhereOperandPtr const & left,WhereOperandPtr const & right)
+    : left(left),right(right) {}
+    virtual bool test() const {return Compare()(left->get(),right->get());}
+};
+
+// compares two integer operands exactly, also 64 bit ones
+template<typename Compare>
+class WhereIntegerCompare : public WhereExpression
+{
+    WhereOperandPtr left;
+    WhereOperandPtr right;
+public:
+    WhereIntegerCompare(WhereOperandPtr const & left,WhereOperandPtr const & right)
+    : left(left),right(right) {}
+    virtual bool test() const
+    {
+        return Compare()(compareIntegers(left->getInteger(),right->getInteger()),0);
+    }
+};
+
+template<template<typename> class Compare>
+static WhereExpressionPtr createCompare(WhereOperandPtr const & left,WhereOperandPtr const & right)
+{
+    if(left->isInteger() && right->isInteger()) {
+        return WhereExpressionPtr(new WhereIntegerCompare<Compare<int> >(left,right));
+    }
+    return WhereExpressionPtr(new WhereCompare<Compare<double> >(left,right));
+}
+
+class WhereTruth : public WhereExpression
+{
+    WhereOperandPtr operand;
+public:
+    explicit WhereTruth(WhereOperandPtr const & operand) : operand(operand) {}
+    virtual bool test() const {return operand->get()!=0.0;}
+};
+
+class WhereNot : public WhereExpression
+{
+    WhereExpressionPtr operand;
+public:
+    explicit WhereNot(WhereExpressionPtr const & operand) : operand(operand) {}
+    virtual bool test() const {return !operand->test();}
+};
+
+class WhereAnd : public WhereExpression
+{
+    WhereExpressionPtr left;
+    WhereExpressionPtr right;
+public:
+    WhereAnd(WhereExpressionPtr const & left,WhereExpressionPtr const & right)
+    : left(left),right(right) {}
+    virtual bool test() const {return left->test() && right->test();}
+};
+
+class WhereOr : public WhereExpression
+{
+    WhereExpressionPtr left;
+    WhereExpressionPtr right;
+public:
+    WhereOr(WhereExpressionPtr const & left,WhereExpressionPtr const & right)
+    : left(left),right(right) {}
+    virtual bool test() const {return left->test() || right->test();}
+};
+
+/*
+ * Recursive descent compiler for
+ *     or         := and { "||" and }
+ *     and        := unary { "&&" unary }
+ *     unary      := "!" unary | "(" or ")" | comparison
+ *     comparison := operand [ relop operand ]
+ *     operand    := number | "true" | "false" | fieldName
+ * Every function returns null if the text is not valid.
+ */
+class WhereCompiler
+{
+    string const & text;
+    size_t pos;
+    PVStructure * top;
+
+    void skipBlanks()
+    {
+        while(pos<text.size() && isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+    }
+    bool accept(const char * token)
+    {
+        skipBlanks();
+        size_t length = strlen(token);
+        if(text.compare(pos,length,token)!=0) return false;
+        pos += length;
+        return true;
+    }
+    WhereOperandPtr fieldOperand(string const & fieldName)
+    {
+        PVScalarPtr pvScalar = top->getSubField<PVScalar>(fieldName);
+        if(!pvScalar) return WhereOperandPtr();
+        switch(pvScalar->getScalar()->getScalarType()) {
+        case pvBoolean: return WhereOperandPtr(new WhereField<boolean>(static_pointer_cast<PVBoolean>(pvScalar)));
+        case pvByte:    return WhereOperandPtr(new WhereField<int8>(static_pointer_cast<PVByte>(pvScalar)));
+        case pvShort:   return WhereOperandPtr(new WhereField<int16>(static_pointer_cast<PVShort>(pvScalar)));
+        case pvInt:     return WhereOperandPtr(new WhereField<int32>(static_pointer_cast<PVInt>(pvScalar)));
+        case pvLong:    return WhereOperandPtr(new WhereField<int64>(static_pointer_cast<PVLong>(pvScalar)));
+        case pvUByte:   return WhereOperandPtr(new WhereField<uint8>(static_pointer_cast<PVUByte>(pvScalar)));
+        case pvUShort:  return WhereOperandPtr(new WhereField<uint16>(static_pointer_cast<PVUShort>(pvScalar)));
+        case pvUInt:    return WhereOperandPtr(new WhereField<uint32>(static_pointer_cast<PVUInt>(pvScalar)));
+        case pvULong:   return WhereOperandPtr(new WhereField<uint64>(static_pointer_cast<PVULong>(pvScalar)));
+        case pvFloat:   return WhereOperandPtr(new WhereField<float>(static_pointer_cast<PVFloat>(pvScalar)));
+        case pvDouble:  return WhereOperandPtr(new WhereField<double>(static_pointer_cast<PVDouble>(pvScalar)));
+        default: break;
+        }
+        return WhereOperandPtr();
+    }
+    // A number with only a sign and digits is an integer, if it fits 64 bits.
+    static WhereOperandPtr integerConstant(const char * start,const char * end)
+    {
+        const char * digits = start;
+        bool negative = *digits=='-';
+        if(negative || *digits=='+') ++digits;
+        if(digits==end) return WhereOperandPtr();
+        for(const char * c=digits; c<end; ++c) {
+            if(!isdigit(static_cast<unsigned char>(*c))) return WhereOperandPtr();
+        }
+        char * last = 0;
+        if(negative) {
+            epicsInt64 value = 0;
+            if(epicsParseInt64(start,&value,10,&last)!=0 || last!=end) return WhereOperandPtr();
+            return WhereOperandPtr(new WhereIntegerConstant(WhereInteger(static_cast<int64>(value))));
+        }
+        epicsUInt64 value = 0;
+        if(epicsParseUInt64(digits,&value,10,&last)!=0 || last!=end) return WhereOperandPtr();
+        return WhereOperandPtr(new WhereIntegerConstant(WhereInteger(static_cast<uint64>(value))));
+    }
+    WhereOperandPtr operand()
+    {
+        skipBlanks();
+        if(pos>=text.size()) return WhereOperandPtr();
+        char c = text[pos];
+        if(isalpha(static_cast<unsigned char>(c)) || c=='_') {
+            size_t start = pos;
+            while(pos<text.size()) {
+                c = text[pos];
+                if(!isalnum(static_cast<unsigned char>(c)) && c!='_' && c!='.') break;
+                ++pos;
+            }
+            string word = text.substr(start,pos-start);
+            if(word=="true") return WhereOperandPtr(new WhereIntegerConstant(WhereInteger(int64(1))));
+            if(word=="false") return WhereOperandPtr(new WhereIntegerConstant(WhereInteger(int64(0))));
+            return fieldOperand(word);
+        }
+        const char * start = text.c_str() + pos;
+        char * end = 0;
+        double value = strtod(start,&end);
+        if(end==start) return WhereOperandPtr();
+        pos += end - start;
+        WhereOperandPtr integer = integerConstant(start,end);
+        if(integer) return integer;
+        return WhereOperandPtr(new WhereConstant(value));
+    }
+    WhereExpressionPtr comparison()
+    {
+        WhereOperandPtr left = operand();
+        if(!left) return WhereExpressionPtr();
+        // the longer tokens first
+        enum {none,eq,ne,le,ge,lt,gt} op = none;
+        if(accept("==")) op = eq;
+        else if(accept("!=")) op = ne;
+        else if(accept("<=")) op = le;
+        else if(accept(">=")) op = ge;
+        else if(accept("<")) op = lt;
+        else if(accept(">")) op = gt;
+        else if(accept("=")) op = eq;
+        if(op==none) return WhereExpressionPtr(new WhereTruth(left));
+        WhereOperandPtr right = operand();
+        if(!right) return WhereExpressionPtr();
+        switch(op) {
+        case eq: return createCompare<std::equal_to>(left,right);
+        case ne: return createCompare<std::not_equal_to>(left,right);
+        case le: return createCompare<std::less_equal>(left,right);
+        case ge: return createCompare<std::greater_equal>(left,right);
+        case lt: return createCompare<std::less>(left,right);
+        case gt: return createCompare<std::greater>(left,right);
+        default: break;
+        }
+        return WhereExpressionPtr();
+    }
+    WhereExpressionPtr unary()
+    {
+        skipBlanks();
+        if(text.compare(pos,2,"!=")!=0 && accept("!")) {
+            WhereExpressionPtr operand = unary();
+            if(!operand) return operand;
+            return WhereExpressionPtr(new WhereNot(operand));
+        }
+        if(accept("(")) {
+            WhereExpressionPtr expression = orExpression();
+            if(!expression || !accept(")")) return WhereExpressionPtr();
+            return expression;
+        }
+        return comparison();
+    }
+    WhereExpressionPtr andExpression()
+    {
+        WhereExpressionPtr left = unary();
+        while(left && accept("&&")) {
+            WhereExpressionPtr right = unary();
+            if(!right) return right;
+            left = WhereExpressionPtr(new WhereAnd(left,right));
+        }
+        return left;
+    }
+    WhereExpressionPtr orExpression()
+    {
+        WhereExpressionPtr left = andExpression();
+        while(left && accept("||")) {
+            WhereExpressionPtr right = andExpression();
+            if(!right) return right;
+            left = WhereExpressionPtr(new WhereOr(left,right));
+        }
+        return left;
+    }
+public:
+    WhereCompiler(string const & text,PVStructure * top)
+    : text(text),pos(0),top(top) {}
+    WhereExpressionPtr compile()
+    {
+        WhereExpressionPtr expression = orExpression();
+        skipBlanks();
+        if(pos!=text.size()) return WhereExpressionPtr();
+        return expression;
+    }
+};
+
+}
+
+PVWherePlugin::PVWherePlugin()
+{
+}
+
+PVWherePlugin::~PVWherePlugin()
+{
+}
+
+void PVWherePlugin::create()
+{
+     static bool firstTime = true;
+     if(firstTime) {
+         firstTime = false;
+         PVWherePluginPtr pvPlugin = PVWherePluginPtr(new PVWherePlugin());
+         PVPluginRegistry::registerPlugin(name,pvPlugin);
+    }
+}
+
+PVFilterPtr PVWherePlugin::create(
+     const std::string & requestValue,
+     const PVCopyPtr & pvCopy,
+     const PVFieldPtr & master)
+{
+    return PVWhereFilter::create(requestValue,master);
+}
+
+PVWhereFilter::~PVWhereFilter()
+{
+}
+
+PVWhereFilterPtr PVWhereFilter::create(
+     const std::string & requestValue,
+     const PVFieldPtr & master)
+{
+    // field names are given from the top of the master
+    PVStructure * top = master->getParent();
+    if(top) {
+        while(top->getParent()) top = top->getParent();
+    } else if(master->getField()->getType()==structure) {
+        top = static_cast<PVStructure *>(master.get());
+    } else {
+        return PVWhereFilterPtr();
+    }
+    WhereCompiler compiler(requestValue,top);
+    WhereExpressionPtr expression = compiler.compile();
+    if(!expression) return PVWhereFilterPtr();
+    PVWhereFilterPtr filter = PVWhereFilterPtr(new PVWhereFilter(expression));
+    return filter;
+}
+
+PVWhereFilter::PVWhereFilter(WhereExpressionPtr const & expression)
+: expression(expression)
+{
+}
+
+bool PVWhereFilter::filter(const PVFieldPtr & pvCopy,const BitSetPtr & bitSet,bool toCopy)
+{
+    if(!toCopy) return false;
+    if(expression->test()) {
+        if(held.nextSetBit(0)>=0) {
+            *bitSet |= held;
+            held.clear();
+        }
+        return false;
+    }
+    held |= *bitSet;
+    bitSet->clear();
+    return true;
+}
+
+string PVWhereFilter::getName()
+{
+    return name;
+}
+
+}}
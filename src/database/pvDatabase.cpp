@@ -21,8 +21,16 @@
 #include "pv/pvDatabase.h"
 #include "pv/pvPlugin.h"
 #include "pv/pvArrayPlugin.h"
+#include "pv/pvBinPlugin.h"
 #include "pv/pvTimestampPlugin.h"
+#include "pv/pvSequencePlugin.h"
 #include "pv/pvDeadbandPlugin.h"
+#include "pv/pvRatePlugin.h"
+#include "pv/pvDecimatePlugin.h"
+#include "pv/pvWherePlugin.h"
+#include "pv/pvRoiPlugin.h"
+#include "pv/pvConvertPlugin.h"
+#include "pv/pvCompressPlugin.h"
 #include "pv/dataDistributorPlugin.h"
 
 using std::tr1::static_pointer_cast;
@@ -43,8 +51,16 @@ PVDatabasePtr PVDatabase::getMaster()
         firstTime = false;
         pvDatabaseMaster = PVDatabasePtr(new PVDatabase());
         PVArrayPlugin::create();
+        PVBinPlugin::create();
         PVTimestampPlugin::create();
+        PVSequencePlugin::create();
         PVDeadbandPlugin::create();
+        PVRatePlugin::create();
+        PVDecimatePlugin::create();
+        PVWherePlugin::create();
+        PVRoiPlugin::create();
+        PVConvertPlugin::create();
+        PVCompressPlugin::create();
         DataDistributorPlugin::create();
     }
     return pvDatabaseMaster;
@@ -9,8 +9,13 @@
  * @date 2012.11.21
  */
 #include <list>
+#include <deque>
+#include <algorithm>
+#include <stdexcept>
 #include <epicsGuard.h>
 #include <epicsThread.h>
+#include <epicsExit.h>
+#include <epicsAtomic.h>
 #include <pv/status.h>
 #include <pv/pvAccess.h>
 #include <pv/createRequest.h>
@@ -35,6 +40,128 @@ using namespace std;
 
 namespace epics { namespace pvDatabase {
 
+// A part of the listeners of a record for parallelEndGroupPut.
+struct EndGroupPutTask
+{
+    PVRecordPtr pvRecord;
+    PVListenerPtr const * listeners;
+    size_t number;
+    size_t * numberTasks;
+    Event * done;
+    // set to the message of the exception that stopped the task
+    string * error;
+};
+
+/*
+ * A thread that calls endGroupPut for parts of the listeners of records.
+ * Part i of every record is handled by the same thread.
+ * stop runs the tasks already added and joins the thread,
+ * a task added after stop runs on the calling thread.
+ */
+class ListenerThread :
+    public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(ListenerThread);
+    ListenerThread()
+    : stopping(false),
+      thread(*this,"pvRecordListener",
+          epicsThreadGetStackSize(epicsThreadStackSmall),
+          epicsThreadPriorityMedium)
+    {
+        thread.start();
+    }
+    virtual ~ListenerThread()
+    {
+        stop();
+    }
+    void add(EndGroupPutTask const & task)
+    {
+        {
+            Lock xx(mutex);
+            if(!stopping) {
+                tasks.push_back(task);
+                wakeup.signal();
+                return;
+            }
+        }
+        runTask(task);
+    }
+    void stop()
+    {
+        {
+            Lock xx(mutex);
+            if(stopping) return;
+            stopping = true;
+        }
+        wakeup.signal();
+        if(!thread.isCurrentThread()) thread.exitWait();
+    }
+    virtual void run()
+    {
+        while(true) {
+            wakeup.wait();
+            while(true) {
+                EndGroupPutTask task;
+                {
+                    Lock xx(mutex);
+                    if(tasks.empty()) {
+                        if(stopping) return;
+                        break;
+                    }
+                    task = tasks.front();
+                    tasks.pop_front();
+                }
+                runTask(task);
+            }
+        }
+    }
+private:
+    // Like the part of the caller, a task stops at the first exception of a listener,
+    // endGroupPut throws it after all parts are done.
+    static void runTask(EndGroupPutTask const & task)
+    {
+        try {
+            for(size_t i=0; i<task.number; ++i) {
+                task.listeners[i]->endGroupPut(task.pvRecord);
+            }
+        } catch(std::exception& e) {
+            *task.error = string("listener exception ") + e.what();
+        } catch(...) {
+            *task.error = "listener exception";
+        }
+        if(epicsAtomicDecrSizeT(task.numberTasks)==0) task.done->signal();
+    }
+    std::deque<EndGroupPutTask> tasks;
+    bool stopping;
+    Event wakeup;
+    Mutex mutex;
+    epicsThread thread;
+};
+
+static std::vector<ListenerThread::shared_pointer> listenerThreadPool;
+static Mutex listenerThreadPoolMutex;
+
+static void listenerThreadPoolExit(void *)
+{
+    std::vector<ListenerThread::shared_pointer> pool;
+    {
+        Lock xx(listenerThreadPoolMutex);
+        pool = listenerThreadPool;
+    }
+    for(size_t i=0; i<pool.size(); ++i) pool[i]->stop();
+}
+
+static ListenerThread::shared_pointer getListenerThread(size_t index)
+{
+    Lock xx(listenerThreadPoolMutex);
+    if(listenerThreadPool.empty()) epicsAtExit(listenerThreadPoolExit,0);
+    while(listenerThreadPool.size()<=index) {
+        listenerThreadPool.push_back(ListenerThread::shared_pointer(new ListenerThread()));
+    }
+    return listenerThreadPool[index];
+}
+
 PVRecordPtr PVRecord::create(
     string const &recordName,
     PVStructurePtr const & pvStructure,
@@ -57,7 +184,11 @@ PVRecord::PVRecord(
 : recordName(recordName),
   pvStructure(pvStructure),
   depthGroupPut(0),
+  sequenceNumber(new uint64(0)),
   traceLevel(0),
+  arrayReplace(false),
+  listenerThreads(1),
+  numberListenerTasks(0),
   isAddListener(false),
   asLevel(asLevel_),
   asGroup(asGroup_)
@@ -233,6 +364,21 @@ bool PVRecord::addPVRecordClient(PVRecordClientPtr const & pvRecordClient)
     return true;
 }
 
+// Insert pvListener after the listeners with the same or a higher priority.
+static void insertListener(
+    std::list<PVListenerWPtr> & pvListenerList,
+    PVListenerPtr const & pvListener)
+{
+    int priority = pvListener->getPriority();
+    std::list<PVListenerWPtr>::iterator iter = pvListenerList.begin();
+    while(iter!=pvListenerList.end()) {
+        PVListenerPtr listener = iter->lock();
+        if(listener && listener->getPriority()<priority) break;
+        ++iter;
+    }
+    pvListenerList.insert(iter,pvListener);
+}
+
 bool PVRecord::addListener(
     PVListenerPtr const & pvListener,
     epics::pvCopy::PVCopyPtr const & pvCopy)
@@ -241,7 +387,7 @@ bool PVRecord::addListener(
         cout << "PVRecord::addListener() " << recordName << endl;
     }
     epicsGuard<epics::pvData::Mutex> guard(mutex);
-    pvListenerList.push_back(pvListener);
+    insertListener(pvListenerList,pvListener);
     this->pvListener = pvListener;
     isAddListener = true;
     pvCopy->traverseMaster(shared_from_this());
@@ -304,9 +450,14 @@ void PVRecord::beginGroupPut()
 void PVRecord::endGroupPut()
 {
    if(--depthGroupPut>0) return;
+   ++*sequenceNumber;
     if(traceLevel>2) {
         cout << "PVRecord::endGroupPut() " << recordName << endl;
     }
+   if(listenerThreads>1 && pvListenerList.size()>1) {
+       parallelEndGroupPut();
+       return;
+   }
    std::list<PVListenerWPtr>::iterator iter;
    for (iter = pvListenerList.begin(); iter!=pvListenerList.end(); iter++)
    {
@@ -316,6 +467,58 @@ void PVRecord::endGroupPut()
    }
 }
 
+static bool isSerialListener(PVListenerPtr const & listener)
+{
+    return !listener->isParallelSafe();
+}
+
+void PVRecord::parallelEndGroupPut()
+{
+    // the listeners that are not parallel safe run on this thread, before the parts
+    listenerSnapshot.clear();
+    std::list<PVListenerWPtr>::iterator iter;
+    for (iter = pvListenerList.begin(); iter!=pvListenerList.end(); iter++)
+    {
+        PVListenerPtr listener = iter->lock();
+        if(listener) listenerSnapshot.push_back(listener);
+    }
+    size_t numberSerial = std::stable_partition(
+        listenerSnapshot.begin(),listenerSnapshot.end(),isSerialListener)
+        - listenerSnapshot.begin();
+    size_t number = listenerSnapshot.size() - numberSerial;
+    size_t numberParts = listenerThreads<number ? listenerThreads : number;
+    PVRecordPtr self = shared_from_this();
+    numberListenerTasks = numberParts>1 ? numberParts - 1 : 0;
+    listenerTaskErrors.assign(numberListenerTasks,string());
+    for(size_t part=1; part<numberParts; ++part) {
+        size_t begin = numberSerial + part*number/numberParts;
+        size_t end = numberSerial + (part + 1)*number/numberParts;
+        EndGroupPutTask task;
+        task.pvRecord = self;
+        task.listeners = &listenerSnapshot[begin];
+        task.number = end - begin;
+        task.numberTasks = &numberListenerTasks;
+        task.done = &listenerTasksDone;
+        task.error = &listenerTaskErrors[part - 1];
+        getListenerThread(part - 1)->add(task);
+    }
+    size_t end = numberSerial + (numberParts>0 ? number/numberParts : 0);
+    try {
+        for(size_t i=0; i<end; ++i) listenerSnapshot[i]->endGroupPut(self);
+    } catch(...) {
+        if(numberParts>1) listenerTasksDone.wait();
+        listenerSnapshot.clear();
+        throw;
+    }
+    if(numberParts>1) listenerTasksDone.wait();
+    listenerSnapshot.clear();
+    for(size_t i=0; i<listenerTaskErrors.size(); ++i) {
+        if(listenerTaskErrors[i].empty()) continue;
+        throw std::runtime_error("PVRecord::endGroupPut() " + recordName
+            + " " + listenerTaskErrors[i]);
+    }
+}
+
 std::ostream& operator<<(std::ostream& o, const PVRecord& record)
 {
     o << format::indent() << "record " << record.getRecordName() << endl;
@@ -378,7 +581,7 @@ bool PVRecordField::addListener(PVListenerPtr const & pvListener)
     if(pvRecord && pvRecord->getTraceLevel()>1) {
          cout << "PVRecordField::addListener() " << getFullName() << endl;
     }
-    pvListenerList.push_back(pvListener);
+    insertListener(pvListenerList,pvListener);
     return true;
 }
 
@@ -401,6 +604,9 @@ void PVRecordField::removeListener(PVListenerPtr const & pvListener)
 
 void PVRecordField::postPut()
 {
+    // a put outside of a group is an update by itself
+    PVRecordPtr record(pvRecord.lock());
+    if(record && record->depthGroupPut==0) ++*record->sequenceNumber;
     PVRecordStructurePtr parent(this->parent.lock());;
     if(parent) {
         parent->postParent(shared_from_this());
@@ -16,6 +16,7 @@
 #include <stdexcept>
 #include <memory>
 #include <set>
+#include <vector>
 
 #include <pv/lock.h>
 #include <pv/pvType.h>
@@ -44,6 +45,184 @@ epicsShareFunc epics::pvData::MonitorPtr createMonitorLocal(
     epics::pvData::MonitorRequester::shared_pointer const & monitorRequester,
     epics::pvData::PVStructurePtr const & pvRequest);
 
+/**
+ * @brief Create a monitor of a record with a channel priority.
+ *
+ * Monitors with a higher priority are copied and notified first
+ * when the record changes, and with record._options.dispatch=true are
+ * dispatched first, so under overload lower priorities are coalesced first.
+ * The three argument version uses ChannelProvider::PRIORITY_DEFAULT.
+ * @param pvRecord The record.
+ * @param monitorRequester The client callback.
+ * @param pvRequest The request.
+ * @param priority The channel priority, see ChannelProvider::createChannel.
+ * @return The monitor or null if the request is not valid.
+ */
+epicsShareFunc epics::pvData::MonitorPtr createMonitorLocal(
+    PVRecordPtr const & pvRecord,
+    epics::pvData::MonitorRequester::shared_pointer const & monitorRequester,
+    epics::pvData::PVStructurePtr const & pvRequest,
+    short priority);
+
+/**
+ * @brief Statistics of a monitor created by createMonitorLocal.
+ *
+ * The overflow policy is selected by record._options.overflow:
+ * coalesce (the default) merges updates into the element being filled,
+ * dropOldest discards the oldest queued element so the newest queueSize are kept,
+ * and block makes the producer wait up to record._options.blockTimeout seconds
+ * (default 0.01) for the client to release an element, then coalesces.
+ * The writer waits with the record locked, so one slow client stalls every
+ * writer and every other monitor of the record. With dispatch=true the
+ * dispatcher thread waits instead, without the record lock, and the changes
+ * made meanwhile are merged into the element being filled.
+ *
+ * If record._options.maxQueueSize is larger than queueSize the queue size is adaptive:
+ * it grows by one element instead of overflowing, up to maxQueueSize,
+ * and shrinks back towards 2 while the client keeps it less than half used.
+ *
+ * With record._options.dispatch=true a record put only marks the monitor changed.
+ * A shared pool of dispatcher threads copies the data and calls monitorEvent,
+ * so changes made before the dispatcher reaches the monitor are sent as one element.
+ *
+ * With record._options.notify=edge monitorEvent is only called for the first
+ * element queued after poll returned null, the default notify=all calls it
+ * for every element. An edge triggered client must poll until poll returns null.
+ *
+ * With record._options.pipeline=true the monitor starts with queueSize credits,
+ * uses one for each queued element, and gets them back through reportRemoteQueueStatus,
+ * which the client calls as it frees elements (ackAny tells the client how often).
+ * While no credit is left nothing is copied, changes accumulate until credits return.
+ *
+ * With record._options.batch=N and/or record._options.batchPeriod=seconds
+ * each update is a sample: the requested fields must all be scalars
+ * (in any substructure), and the monitor sends a structure of the same fields
+ * as arrays of the same type holding N samples, or the samples of one period.
+ * The period starts with the first sample of a batch; a timer sends the batch
+ * when the period expires, even if no further update arrives.
+ *
+ * With record._options.sharedPool=true the monitor borrows its elements from a pool
+ * shared by all such monitors whose elements have the same structure, and returns
+ * them when the client releases them. The queue has max(queueSize,maxQueueSize) slots
+ * but only holds the elements in use, an idle monitor just its active element.
+ * Only the fields in changedBitSet of an element are valid.
+ *
+ * With record._options.replay=N start queues the last N updates of the record,
+ * the oldest with all fields marked changed, before the initial element.
+ * The updates are kept in a ring of record snapshots shared by all monitors of
+ * the record, which exists from the first monitor that asks for replay or resume
+ * until the last such monitor is destroyed.
+ * The queue size is at least N+2. Plugins are not applied to replayed updates,
+ * except that fields with the request option sequence=true get the sequence number
+ * of the replayed update, see PVRecord::getSequenceNumber.
+ *
+ * With record._options.resume=S a client that saw the update with sequence number S
+ * resumes: start queues the updates after S instead of the initial element.
+ * If more than N updates, default 16, followed S or the ring no longer has them,
+ * start queues a complete initial element as usual. See getResumeRange.
+ */
+struct epicsShareClass MonitorLocalStats
+{
+    /**
+     * Bucket i of a latency histogram counts latencies of at least 2^i
+     * and less than 2^(i+1) microseconds, bucket 0 also counts shorter ones
+     * and the last bucket also longer ones.
+     */
+    enum {numberLatencyBuckets = 24};
+    MonitorLocalStats()
+    : queueSize(0),maxQueueSize(0),numberElements(0),numberUsed(0),numberCoalesced(0),
+      numberDropped(0),numberBlocked(0),numberTimeouts(0),
+      numberEvents(0),numberEventsSkipped(0),
+      credits(0),numberDeferred(0),
+      queueHighWater(0),numberOverrunElements(0),numberOverrunFields(0),
+      numberPolled(0),
+      queueLatency(numberLatencyBuckets,0),
+      holdTime(numberLatencyBuckets,0)
+    {}
+    /**
+     * @brief Add the statistics of another monitor.
+     *
+     * queueHighWater becomes the larger of both, everything else is summed.
+     * @param stats The statistics to add.
+     */
+    void add(MonitorLocalStats const & stats);
+    /** The name of the requester. */
+    std::string requesterName;
+    /** The current number of monitor elements. */
+    std::size_t queueSize;
+    /** The largest number of monitor elements. */
+    std::size_t maxQueueSize;
+    /** The number of monitor elements that exist, with sharedPool those in use. */
+    std::size_t numberElements;
+    /** The number of elements waiting to be polled. */
+    std::size_t numberUsed;
+    /** The number of updates merged into a pending element because the queue was full. */
+    std::size_t numberCoalesced;
+    /** The number of queued elements discarded by dropOldest. */
+    std::size_t numberDropped;
+    /** The number of times block waited for a free element. */
+    std::size_t numberBlocked;
+    /** The number of waits that timed out. */
+    std::size_t numberTimeouts;
+    /** The number of monitorEvent calls. */
+    std::size_t numberEvents;
+    /** The number of queued elements that notify=edge did not signal. */
+    std::size_t numberEventsSkipped;
+    /** The credits left with pipeline=true. */
+    int credits;
+    /** The number of updates held back because the client had no credits. */
+    std::size_t numberDeferred;
+    /** The largest number of elements that waited to be polled. */
+    std::size_t queueHighWater;
+    /** The number of queued elements with a non empty overrunBitSet. */
+    std::size_t numberOverrunElements;
+    /** The number of bits set in the overrunBitSet of all queued elements. */
+    std::size_t numberOverrunFields;
+    /** The number of elements returned by poll. */
+    std::size_t numberPolled;
+    /** Histogram of the time from queueing an element until poll returns it. */
+    std::vector<std::size_t> queueLatency;
+    /** Histogram of the time from poll until release of an element. */
+    std::vector<std::size_t> holdTime;
+};
+
+/**
+ * @brief Get the statistics of a monitor.
+ *
+ * @param monitor A monitor created by createMonitorLocal.
+ * @param stats Set to the current statistics.
+ * @return false if monitor was not created by createMonitorLocal.
+ */
+epicsShareFunc bool getMonitorLocalStats(
+    epics::pvData::MonitorPtr const & monitor,
+    MonitorLocalStats & stats);
+
+/**
+ * @brief Get the statistics of all monitors of a record.
+ *
+ * Use MonitorLocalStats::add to aggregate them.
+ * @param pvRecord The record.
+ * @param stats Set to the statistics of each monitor created by createMonitorLocal.
+ */
+epicsShareFunc void getRecordMonitorStats(
+    PVRecordPtr const & pvRecord,
+    std::vector<MonitorLocalStats> & stats);
+
+/**
+ * @brief Get the sequence numbers a monitor of a record can resume after.
+ *
+ * A monitor with record._options.resume=S, S in [first,last], gets the updates
+ * after S, at most replay=N of them, instead of a complete initial element.
+ * @param pvRecord The record.
+ * @param first Set to the first sequence number.
+ * @param last Set to the last, the current sequence number of the record.
+ * @return false if the record has no monitor with replay or resume.
+ */
+epicsShareFunc bool getResumeRange(
+    PVRecordPtr const & pvRecord,
+    epics::pvData::uint64 & first,
+    epics::pvData::uint64 & last);
+
 epicsShareFunc ChannelProviderLocalPtr getChannelProviderLocal();
 
 
@@ -131,7 +310,8 @@ public:
      * @param channelName The name of the channel desired.
      * @param channelRequester The callback to call with the result.
      * @param priority The priority.
-     * This is ignored.
+     * It is kept by the ChannelLocal and given to the monitors it creates,
+     * see createMonitorLocal.
      * @param address The address.
      * This is ignored.
      * @return shared pointer to Channel.
@@ -190,11 +370,13 @@ public:
      * @param channelProvider The channel provider.
      * @param requester The client callback.
      * @param pvRecord The record the channel will access.
+     * @param priority The priority given to the monitors of the channel.
      */
     ChannelLocal(
         ChannelProviderLocalPtr const &channelProvider,
         epics::pvAccess::ChannelRequester::shared_pointer const & requester,
-        PVRecordPtr const & pvRecord
+        PVRecordPtr const & pvRecord,
+        short priority = epics::pvAccess::ChannelProvider::PRIORITY_DEFAULT
     );
     /**
      * @brief Destructor
@@ -368,6 +550,12 @@ public:
      * @return true if client can read
      */
     virtual bool canRead();
+    /**
+     * @brief The priority the channel was created with.
+     *
+     * @return The priority.
+     */
+    short getPriority() const {return priority;}
 protected:
     shared_pointer getPtrSelf()
     {
@@ -377,6 +565,7 @@ private:
     epics::pvAccess::ChannelRequester::shared_pointer requester;
     ChannelProviderLocalWPtr provider;
     PVRecordWPtr pvRecord;
+    short priority;
     epics::pvData::Mutex mutex;
 
     // AS-specific variables/methods
@@ -0,0 +1,109 @@
+/* pvBinPlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVBINPLUGIN_H
+#define PVBINPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVBinPlugin;
+class PVBinFilter;
+
+typedef std::tr1::shared_ptr<PVBinPlugin> PVBinPluginPtr;
+typedef std::tr1::shared_ptr<PVBinFilter> PVBinFilterPtr;
+
+
+/**
+ * @brief A plugin for a filter that reduces a numeric PVScalarArray to a number of bins.
+ *
+ * The request is <b>bin=N</b> or <b>bin=N:mode</b>, for example <b>value[bin=1000:minmax]</b>.
+ * The master array is divided into N bins of consecutive elements, and mode selects
+ * what the copy holds for each bin:
+ * <ul>
+ *   <li><b>mean</b>, the default, the mean of the bin.</li>
+ *   <li><b>minmax</b> the minimum and the maximum of the bin, in the order they occur,
+ *       so the copy has 2N elements and no peak is lost.</li>
+ *   <li><b>lttb</b> one element of the bin selected by the
+ *       largest triangle three buckets algorithm, the first and last element are kept.</li>
+ * </ul>
+ * An array with no more elements than the copy would have is copied as is.
+ * The copy has the element type of the master and a put to it does not modify the master.
+ */
+class epicsShareClass PVBinPlugin : public PVPlugin
+{
+private:
+    PVBinPlugin();
+public:
+    POINTER_DEFINITIONS(PVBinPlugin);
+    virtual ~PVBinPlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that bins a numeric PVScalarArray.
+ */
+class epicsShareClass PVBinFilter : public PVFilter
+{
+public:
+    enum Mode {mean,minmax,lttb};
+private:
+    std::size_t numberBins;
+    Mode mode;
+    epics::pvData::PVScalarArrayPtr masterArray;
+
+    PVBinFilter(
+        std::size_t numberBins,Mode mode,
+        const epics::pvData::PVScalarArrayPtr & masterArray);
+public:
+    POINTER_DEFINITIONS(PVBinFilter);
+    virtual ~PVBinFilter();
+    /**
+     * Create a PVBinFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVBinFilterPtr create(const std::string & requestValue,const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+};
+
+}}
+#endif  /* PVBINPLUGIN_H */
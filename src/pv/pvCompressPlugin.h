@@ -0,0 +1,119 @@
+/* pvCompressPlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVCOMPRESSPLUGIN_H
+#define PVCOMPRESSPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVCompressPlugin;
+class PVCompressFilter;
+
+typedef std::tr1::shared_ptr<PVCompressPlugin> PVCompressPluginPtr;
+typedef std::tr1::shared_ptr<PVCompressFilter> PVCompressFilterPtr;
+
+
+/**
+ * @brief A plugin for a filter that compresses an integer PVScalarArray into a ubyte array.
+ *
+ * The request is <b>compress=delta</b>, for example <b>value[compress=delta]</b>.
+ * The copy is a ubyte array that starts with an 8 byte header:
+ * byte 0 is the codec, 1 for delta, byte 1 is the ScalarType of the master,
+ * bytes 2 and 3 are 0 and bytes 4 to 7 are the number of elements, little endian.
+ * The elements follow in blocks of 128. A block is a byte with a bit width w and then
+ * the difference of each element to the element before it, the first to 0, zigzag encoded
+ * and packed in w bits each, little endian. For a w above 32 the low 32 bits of the
+ * elements of the block come first and then the high w-32 bits.
+ * The compression is lossless, smooth data compresses best.
+ * A client gets the array back with decode.
+ * A put to the copy does not modify the master.
+ */
+class epicsShareClass PVCompressPlugin : public PVPlugin
+{
+private:
+    PVCompressPlugin();
+public:
+    POINTER_DEFINITIONS(PVCompressPlugin);
+    virtual ~PVCompressPlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+    /**
+     * Get the introspection interface of the copy.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return A ubyte scalarArray.
+     */
+    virtual epics::pvData::FieldConstPtr getCopyField(
+         const std::string & requestValue,
+         const epics::pvData::PVFieldPtr & master);
+    /**
+     * Decode a compressed array.
+     * @param encoded The value of the copy.
+     * @return A new array with the element type and elements of the master.
+     * Null is returned if encoded is not valid.
+     */
+    static epics::pvData::PVScalarArrayPtr decode(
+         epics::pvData::shared_vector<const epics::pvData::uint8> const & encoded);
+};
+
+/**
+ * @brief  A filter that compresses an integer PVScalarArray.
+ */
+class epicsShareClass PVCompressFilter : public PVFilter
+{
+private:
+    epics::pvData::PVScalarArrayPtr masterArray;
+
+    PVCompressFilter(const epics::pvData::PVScalarArrayPtr & masterArray);
+public:
+    POINTER_DEFINITIONS(PVCompressFilter);
+    virtual ~PVCompressFilter();
+    /**
+     * Create a PVCompressFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVCompressFilterPtr create(const std::string & requestValue,const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+};
+
+}}
+#endif  /* PVCOMPRESSPLUGIN_H */
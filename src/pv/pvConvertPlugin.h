@@ -0,0 +1,127 @@
+/* pvConvertPlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVCONVERTPLUGIN_H
+#define PVCONVERTPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVConvertPlugin;
+class PVConvertFilter;
+
+typedef std::tr1::shared_ptr<PVConvertPlugin> PVConvertPluginPtr;
+typedef std::tr1::shared_ptr<PVConvertFilter> PVConvertFilterPtr;
+
+
+/**
+ * @brief A plugin for a filter that converts a numeric PVScalarArray to another element type.
+ *
+ * The request is <b>convert=type</b> or <b>convert=type:scale:offset</b>,
+ * for example <b>value[convert=float]</b> or <b>value[convert=short:0.001:-10]</b>,
+ * where type is the name of a numeric scalar type.
+ * Each element of the copy is (master - offset)/scale, so a client gets the master value
+ * back as copy*scale + offset. Conversion to an integer type rounds to the nearest
+ * integer and clips to the range of the type.
+ * The copy has the new element type and a put to it does not modify the master.
+ */
+class epicsShareClass PVConvertPlugin : public PVPlugin
+{
+private:
+    PVConvertPlugin();
+public:
+    POINTER_DEFINITIONS(PVConvertPlugin);
+    virtual ~PVConvertPlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+    /**
+     * Get the introspection interface of the copy.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return A scalarArray with the requested element type.
+     */
+    virtual epics::pvData::FieldConstPtr getCopyField(
+         const std::string & requestValue,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that converts a numeric PVScalarArray.
+ */
+class epicsShareClass PVConvertFilter : public PVFilter
+{
+private:
+    epics::pvData::ScalarType elementType;
+    double scale;
+    double offset;
+    epics::pvData::PVScalarArrayPtr masterArray;
+
+    PVConvertFilter(
+        epics::pvData::ScalarType elementType,double scale,double offset,
+        const epics::pvData::PVScalarArrayPtr & masterArray);
+public:
+    POINTER_DEFINITIONS(PVConvertFilter);
+    virtual ~PVConvertFilter();
+    /**
+     * Get the element type of the copy.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @param elementType The element type for the copy.
+     * @param scale The scale.
+     * @param offset The offset.
+     * @return (false,true) if requestValue (is not, is) valid for master.
+     */
+    static bool parse(
+        const std::string & requestValue,
+        const epics::pvData::PVFieldPtr & master,
+        epics::pvData::ScalarType & elementType,
+        double & scale,
+        double & offset);
+    /**
+     * Create a PVConvertFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVConvertFilterPtr create(const std::string & requestValue,const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+};
+
+}}
+#endif  /* PVCONVERTPLUGIN_H */
@@ -10,6 +10,7 @@
 #include <map>
 
 #include <pv/pvData.h>
+#include <pv/event.h>
 #include <pv/pvTimeStamp.h>
 #include <pv/rpcService.h>
 #include <pv/pvStructureCopy.h>
@@ -193,6 +194,8 @@ public:
      * @brief Add a PVListener.
      *
      * This must be called before calling pvRecordField.addListener.
+     * Listeners are called in the order of PVListener::getPriority,
+     * listeners with equal priority in the order they were added.
      * @param pvListener The listener.
      * @param pvCopy The pvStructure that has the client fields.
      * @return <b>true</b> if the listener was added.
@@ -224,8 +227,52 @@ public:
     void beginGroupPut();
     /**
      * @brief Ends a group of puts.
+     *
+     * With more than one listener thread, see setListenerThreads,
+     * the endGroupPut calls to the listeners are made in parallel.
      */
     void endGroupPut();
+    /**
+     * @brief Get the update sequence number.
+     *
+     * The number is incremented by each endGroupPut that ends the outermost group
+     * and by each put to a field outside of a group, before the listeners are called,
+     * so every update a listener sees has its own number.
+     * A copy can carry it by the request option <b>sequence=true</b> on a numeric scalar,
+     * e.g. <b>timeStamp.userTag[sequence=true]</b>.
+     * The record must be locked.
+     * @return The number of updates since the record was created.
+     */
+    epics::pvData::uint64 getSequenceNumber() const {return *sequenceNumber;}
+    /**
+     * @brief Get the update sequence number for the copies of the record.
+     *
+     * Code that creates a PVCopy of the record passes it to PVCopy::create,
+     * so the sequence plugin can read the number of the record it copies.
+     * @return The sequence number, shared with the record.
+     */
+    epics::pvCopy::SequenceNumberConstPtr getSequenceNumberPtr() const {return sequenceNumber;}
+    /**
+     * @brief Get the number of threads that call endGroupPut of the listeners.
+     * @return The number.
+     */
+    std::size_t getListenerThreads() const {return listenerThreads;}
+    /**
+     * @brief Set the number of threads that call endGroupPut of the listeners.
+     *
+     * With N larger than 1 endGroupPut splits the listeners into N parts.
+     * The caller handles the first part, threads shared by all records the others,
+     * and endGroupPut returns when all parts are done, so each listener still sees
+     * the group puts in order. The record stays locked meanwhile, so a listener
+     * reads a consistent record. Only listeners that return true from
+     * PVListener::isParallelSafe are put into the parts, the others are called
+     * by the caller first.
+     * An exception of a listener stops its part, and endGroupPut throws it,
+     * as a std::runtime_error for a part of another thread, after all parts are done.
+     * This helps records with many monitors, which copy data in endGroupPut.
+     * @param number The number of threads, the default 1 means the caller does all.
+     */
+    void setListenerThreads(std::size_t number) {listenerThreads = number;}
     /**
      * @brief get trace level (0,1,2) means (nothing,lifetime,process)
      * @return the level
@@ -236,6 +283,21 @@ public:
      * @param level The level
      */
     void setTraceLevel(int level) {traceLevel = level;}
+    /**
+     * @brief Do channel puts move array buffers into the record?
+     *
+     * If <b>true</b> a channelPut or channelPutGet gives the record the frozen buffer
+     * of each array it writes and then drops its own reference.
+     * The writer therefore always fills a fresh buffer and never pays
+     * for a copy on write of a buffer shared by monitors.
+     * @return The option.
+     */
+    bool getArrayReplace() const {return arrayReplace;}
+    /**
+     * @brief Set the array replace option. The default is <b>false</b>.
+     * @param value The new value.
+     */
+    void setArrayReplace(bool value) {arrayReplace = value;}
     /**
      * @brief Get the ASlevel 
      *
@@ -278,7 +340,9 @@ protected:
     void initPVRecord();
 private:
     friend class PVDatabase;
+    friend class PVRecordField;
     void unlistenClients();
+    void parallelEndGroupPut();
 
     PVRecordFieldPtr findPVRecordField(
         PVRecordStructurePtr const & pvrs,
@@ -291,7 +355,16 @@ private:
     std::list<PVRecordClientWPtr> clientList;
     epics::pvData::Mutex mutex;
     std::size_t depthGroupPut;
+    std::tr1::shared_ptr<epics::pvData::uint64> sequenceNumber;
     int traceLevel;
+    bool arrayReplace;
+    std::size_t listenerThreads;
+    // only used by parallelEndGroupPut
+    std::vector<PVListenerPtr> listenerSnapshot;
+    std::size_t numberListenerTasks;
+    epics::pvData::Event listenerTasksDone;
+    // the exceptions of the parts run by the listener threads
+    std::vector<std::string> listenerTaskErrors;
     // following only valid while addListener or removeListener is active.
     bool isAddListener;
     PVListenerWPtr pvListener;
@@ -463,6 +536,21 @@ public:
      * @brief Destructor.
      */
     virtual ~PVListener() {}
+    /**
+     * @brief The priority of the listener.
+     *
+     * A record calls listeners with a higher priority first.
+     * @return The priority, 0 unless overridden.
+     */
+    virtual int getPriority() const {return 0;}
+    /**
+     * @brief Can endGroupPut be called by another thread while the record is locked?
+     *
+     * A listener that neither locks the record nor calls back into it
+     * can return true, see PVRecord::setListenerThreads.
+     * @return false unless overridden.
+     */
+    virtual bool isParallelSafe() const {return false;}
     /**
      * @brief pvField has been modified.
      *
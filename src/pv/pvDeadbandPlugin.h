@@ -27,6 +27,17 @@ typedef std::tr1::shared_ptr<PVDeadbandFilter> PVDeadbandFilterPtr;
 /**
  * @brief  A plugin for a filter that gets a sub array from a PVScalarDeadband.
  *
+ * For a numeric scalar the request is <b>deadband=abs:X</b> or <b>deadband=rel:X</b>,
+ * a change is reported if it is at least X or X percent of the last reported value.
+ * For a numeric scalar array the request is <b>deadband=mode:X</b> and a change
+ * is reported if, compared with the last reported array,
+ * <ul>
+ *   <li><b>abs</b> an element changed by at least X,</li>
+ *   <li><b>rms</b> the root mean square of the element changes is at least X,</li>
+ *   <li><b>rel</b> the norm of the change is at least X percent of the norm of the array.</li>
+ * </ul>
+ * A change of the array length is always reported.
+ *
  * @author mrk
  * @since date 2017.02.23
  */
@@ -61,14 +72,30 @@ public:
 class epicsShareClass PVDeadbandFilter : public PVFilter
 {
 private:
+    // copies a scalar master to copy and decides in its type if it is reported
+    typedef bool (*ReportScalarFunc)(
+        epics::pvData::PVScalar const & master,
+        epics::pvData::PVField & copy,
+        epics::pvData::PVScalar & lastReported,
+        bool firstTime,bool absolute,double deadband);
     bool absolute;
+    // only for arrays, rms instead of abs
+    bool rms;
     double deadband;
     epics::pvData::PVScalarPtr master;
+    epics::pvData::PVScalarArrayPtr masterArray;
     bool firstTime;
-    double lastReportedValue;
+    ReportScalarFunc reportScalar;
+    epics::pvData::PVScalarPtr lastReported;
+    // the buffer is shared with the master, arrays are frozen
+    epics::pvData::shared_vector<const void> lastReportedArray;
 
 
     PVDeadbandFilter(bool absolute,double deadband,epics::pvData::PVScalarPtr const & master);
+    PVDeadbandFilter(
+        bool absolute,bool rms,double deadband,
+        epics::pvData::PVScalarArrayPtr const & masterArray);
+    bool filterArray(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet);
 public:
     POINTER_DEFINITIONS(PVDeadbandFilter);
     virtual ~PVDeadbandFilter();
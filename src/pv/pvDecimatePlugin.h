@@ -0,0 +1,107 @@
+/* pvDecimatePlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVDECIMATEPLUGIN_H
+#define PVDECIMATEPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVDecimatePlugin;
+class PVDecimateFilter;
+
+typedef std::tr1::shared_ptr<PVDecimatePlugin> PVDecimatePluginPtr;
+typedef std::tr1::shared_ptr<PVDecimateFilter> PVDecimateFilterPtr;
+
+
+/**
+ * @brief  A plugin for a filter that reports every Nth change of a field.
+ *
+ * A request like <b>field(value[decimate=10])</b> reports the first change of
+ * value and then every 10th change, with no time basis.
+ * The filter is a condition: the whole update is suppressed between the reported
+ * changes, and the changes of the other fields are sent with the next reported one.
+ */
+class epicsShareClass PVDecimatePlugin : public PVPlugin
+{
+private:
+    PVDecimatePlugin();
+public:
+    POINTER_DEFINITIONS(PVDecimatePlugin);
+    virtual ~PVDecimatePlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that clears the bitSet of an update unless it is one change of a field in N.
+ */
+class epicsShareClass PVDecimateFilter : public PVFilter
+{
+private:
+    epicsUInt32 factor;
+    // number of changes since the last reported one
+    epicsUInt32 count;
+    // the changes of suppressed updates
+    epics::pvData::BitSet held;
+
+    PVDecimateFilter(epicsUInt32 factor);
+public:
+    POINTER_DEFINITIONS(PVDecimateFilter);
+    virtual ~PVDecimateFilter();
+    /**
+     * Create a PVDecimateFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVDecimateFilterPtr create(
+        const std::string & requestValue,
+        const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+    /**
+     * The filter decides if an update is reported.
+     * @return true
+     */
+    virtual bool isCondition() {return true;}
+};
+
+}}
+#endif  /* PVDECIMATEPLUGIN_H */
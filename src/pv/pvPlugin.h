@@ -11,7 +11,9 @@
 
 #include <string>
 #include <map>
+#include <vector>
 #include <pv/lock.h>
+#include <pv/pvData.h>
 #include <pv/bitSet.h>
 
 #include <shareLib.h>
@@ -57,6 +59,21 @@ public:
          const std::string & requestValue,
          const PVCopyPtr & pvCopy,
          const epics::pvData::PVFieldPtr & master) = 0;
+    /**
+     * Get the introspection interface of the copy of a field.
+     * PVCopy calls this when it creates the structure of the copy, before create.
+     * A PVFilter for a copy with another type must always return true from filter.
+     * It is then the only filter of the field, the other plugins in its options are not used.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The Field for the copy or null if the copy has the type of master, the default.
+     */
+    virtual epics::pvData::FieldConstPtr getCopyField(
+         const std::string & requestValue,
+         const epics::pvData::PVFieldPtr & master)
+    {
+        return epics::pvData::FieldConstPtr();
+    }
 };
 
 /**
@@ -83,6 +100,29 @@ public:
      * @return The name.
      */
     virtual std::string getName() = 0;
+    /**
+     * Is the value the filter puts into the copy independent of the master?
+     * PVCopy calls a volatile filter on every update that changes the copy,
+     * not only when the bit for its master field is set.
+     * @return (false,true) means (no,yes), the default is false.
+     */
+    virtual bool isVolatile() {return false;}
+    /**
+     * Does the filter decide if an update of the copy is reported?
+     * PVCopy calls a condition filter after every update that changes the copy,
+     * after the volatile filters, with the bitSet of all changes.
+     * The filter clears the bitSet to suppress the update.
+     * The field to which it is attached is copied as if it had no filter.
+     * @return (false,true) means (no,yes), the default is false.
+     */
+    virtual bool isCondition() {return false;}
+    /**
+     * Get the other fields of the copy that the filter writes.
+     * The names are relative to the structure that holds the field of the filter.
+     * PVCopy does not update these fields from the master or the master from them.
+     * @return The field names, the default is none.
+     */
+    virtual std::vector<std::string> getDependentFields() {return std::vector<std::string>();}
 };
 /**
  * @brief  A registry for filter plugins for PVCopy.
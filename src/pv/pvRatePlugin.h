@@ -0,0 +1,124 @@
+/* pvRatePlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVRATEPLUGIN_H
+#define PVRATEPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/timer.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVRatePlugin;
+class PVRateFilter;
+
+typedef std::tr1::shared_ptr<PVRatePlugin> PVRatePluginPtr;
+typedef std::tr1::shared_ptr<PVRateFilter> PVRateFilterPtr;
+
+
+/**
+ * @brief  A plugin for a filter that limits the update rate of a field.
+ *
+ * A request like <b>field(value[rate=10])</b> reports a change of value at most
+ * 10 times per second. A change that comes sooner is held back, not copied, and
+ * when the interval has passed the latest value of the master is copied and
+ * reported even if the master does not change again, so the final state is never lost.
+ * The trailing update needs the owner of the PVCopy to be a PVCopyFlushRequester.
+ */
+class epicsShareClass PVRatePlugin : public PVPlugin
+{
+private:
+    PVRatePlugin();
+public:
+    POINTER_DEFINITIONS(PVRatePlugin);
+    virtual ~PVRatePlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that reports changes of a field at most at a maximum rate.
+ */
+class epicsShareClass PVRateFilter :
+    public PVFilter,
+    public epics::pvData::TimerCallback,
+    public std::tr1::enable_shared_from_this<PVRateFilter>
+{
+private:
+    epicsUInt64 interval;
+    epics::pvData::PVFieldPtr master;
+    std::tr1::weak_ptr<PVCopy> pvCopy;
+    epics::pvData::Mutex mutex;
+    bool firstTime;
+    epicsUInt64 lastReported;
+    // a change is held back, and the timer is scheduled to flush it
+    bool pending;
+    bool scheduled;
+    std::size_t copyOffset;
+
+    PVRateFilter(
+        double interval,
+        PVCopyPtr const & pvCopy,
+        epics::pvData::PVFieldPtr const & master);
+public:
+    POINTER_DEFINITIONS(PVRateFilter);
+    virtual ~PVRateFilter();
+    /**
+     * Create a PVRateFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVRateFilterPtr create(
+        const std::string & requestValue,
+        const PVCopyPtr & pvCopy,
+        const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+    /**
+     * The timer expired, flush a change that was held back.
+     */
+    virtual void callback();
+    /**
+     * The timer was stopped.
+     */
+    virtual void timerStopped();
+};
+
+}}
+#endif  /* PVRATEPLUGIN_H */
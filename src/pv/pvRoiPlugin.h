@@ -0,0 +1,121 @@
+/* pvRoiPlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVROIPLUGIN_H
+#define PVROIPLUGIN_H
+
+#include <string>
+#include <map>
+#include <vector>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVRoiPlugin;
+class PVRoiFilter;
+
+typedef std::tr1::shared_ptr<PVRoiPlugin> PVRoiPluginPtr;
+typedef std::tr1::shared_ptr<PVRoiFilter> PVRoiFilterPtr;
+
+
+/**
+ * @brief A plugin for a filter that gets a region of a 2D image in NTNDArray layout.
+ *
+ * The filter is attached to the value union of an NTNDArray, it is not created
+ * for a variant union, and the structure that holds value must have a dimension array.
+ * The request is <b>roi=x:y:width:height</b> or <b>roi=x:y:width:height:binX:binY</b>,
+ * for example <b>field(value[roi=512:512:1024:1024:2:2],dimension)</b>.
+ * A width or height of 0 means up to the edge of the image, and the region is clipped
+ * to the image. With binning each element of the copy is the mean of binX by binY
+ * elements, binX and binY are at most 64.
+ * The dimension field of the copy describes the region, its offset and binning
+ * are in the pixels of the detector like those of NDArray.
+ * A value that is not a 2D numeric image is copied as is.
+ * The copy has the element type of the master and a put to it does not modify the master.
+ */
+class epicsShareClass PVRoiPlugin : public PVPlugin
+{
+private:
+    PVRoiPlugin();
+public:
+    POINTER_DEFINITIONS(PVRoiPlugin);
+    virtual ~PVRoiPlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that copies a region of an image and its dimension.
+ */
+class epicsShareClass PVRoiFilter : public PVFilter
+{
+private:
+    std::size_t x;
+    std::size_t y;
+    std::size_t width;
+    std::size_t height;
+    std::size_t binX;
+    std::size_t binY;
+    epics::pvData::PVUnionPtr masterValue;
+    epics::pvData::PVStructureArrayPtr masterDimension;
+
+    PVRoiFilter(
+        std::vector<std::size_t> const & region,
+        epics::pvData::PVUnionPtr const & masterValue,
+        epics::pvData::PVStructureArrayPtr const & masterDimension);
+    bool putDimension(
+        epics::pvData::PVStructureArray & copyDimension,
+        std::size_t const first[2],std::size_t const size[2]);
+public:
+    POINTER_DEFINITIONS(PVRoiFilter);
+    virtual ~PVRoiFilter();
+    /**
+     * Create a PVRoiFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVRoiFilterPtr create(const std::string & requestValue,const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+    /**
+     * The filter writes the dimension of the copy.
+     * @return dimension
+     */
+    virtual std::vector<std::string> getDependentFields();
+};
+
+}}
+#endif  /* PVROIPLUGIN_H */
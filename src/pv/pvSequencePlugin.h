@@ -0,0 +1,108 @@
+/* pvSequencePlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVSEQUENCEPLUGIN_H
+#define PVSEQUENCEPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/pvPlugin.h>
+#include <pv/pvStructureCopy.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVSequencePlugin;
+class PVSequenceFilter;
+
+typedef std::tr1::shared_ptr<PVSequencePlugin> PVSequencePluginPtr;
+typedef std::tr1::shared_ptr<PVSequenceFilter> PVSequenceFilterPtr;
+
+
+/**
+ * @brief  A plugin for a filter that sets a numeric scalar to the update sequence number of the master.
+ *
+ * A request like <b>timeStamp.userTag[sequence=true]</b> makes each update
+ * of the copy carry the sequence number, so a client can detect gaps.
+ * The sequence number is the one given to PVCopy::create,
+ * for a PVRecord PVRecord::getSequenceNumberPtr.
+ * The filter is not created for a PVCopy without one.
+ */
+class epicsShareClass PVSequencePlugin : public PVPlugin
+{
+private:
+    PVSequencePlugin();
+public:
+    POINTER_DEFINITIONS(PVSequencePlugin);
+    virtual ~PVSequencePlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that sets a numeric scalar of the copy to the sequence number of the master.
+ *
+ * The filter is volatile and the field is read only: a put to it does not modify the master.
+ */
+class epicsShareClass PVSequenceFilter : public PVFilter
+{
+private:
+    SequenceNumberConstPtr sequenceNumber;
+
+    PVSequenceFilter(SequenceNumberConstPtr const & sequenceNumber);
+public:
+    POINTER_DEFINITIONS(PVSequenceFilter);
+    virtual ~PVSequenceFilter();
+    /**
+     * Create a PVSequenceFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    static PVSequenceFilterPtr create(
+        const std::string & requestValue,
+        const PVCopyPtr & pvCopy,
+        const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+    /**
+     * The sequence number changes with every update of the master.
+     * @return true.
+     */
+    bool isVolatile() {return true;}
+};
+
+}}
+#endif  /* PVSEQUENCEPLUGIN_H */
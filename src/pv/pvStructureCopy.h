@@ -45,10 +45,36 @@ public:
     virtual void nextMasterPVField(epics::pvData::PVFieldPtr const &pvField) = 0;
 };
 
+class PVCopyFlushRequester;
+typedef std::tr1::shared_ptr<PVCopyFlushRequester> PVCopyFlushRequesterPtr;
+typedef std::tr1::weak_ptr<PVCopyFlushRequester> PVCopyFlushRequesterWPtr;
+
+/**
+ * @brief Callback for filters that hold back a change of a field.
+ *
+ * Implemented by code that creates pvCopy and keeps copies up to date,
+ * e.g. a monitor. A filter that cleared the bit of a changed field
+ * calls PVCopy::flush later, so the change is not lost.
+ */
+class epicsShareClass PVCopyFlushRequester
+{
+public:
+    POINTER_DEFINITIONS(PVCopyFlushRequester);
+    virtual ~PVCopyFlushRequester() {}
+    /**
+     * Update the copies for a field as if its master field had changed.
+     * Called without a lock held, the requester must lock the master.
+     * @param copyOffset The offset of the field in the copy.
+     */
+    virtual void flush(std::size_t copyOffset) = 0;
+};
+
 
 class PVCopy;
 typedef std::tr1::shared_ptr<PVCopy> PVCopyPtr;
 
+typedef std::tr1::shared_ptr<const epics::pvData::uint64> SequenceNumberConstPtr;
+
 struct CopyNode;
 typedef std::tr1::shared_ptr<CopyNode> CopyNodePtr;
 
@@ -61,6 +87,12 @@ typedef std::tr1::shared_ptr<CopyStructureNode> CopyStructureNodePtr;
  *
  * Class that manages one or more PVStructures that holds an arbitrary subset of the fields
  * in another PVStructure called master.
+ *
+ * A scalarArray field that has no filter is never copied element by element.
+ * The copy shares the frozen buffer of the source,
+ * i.e. it calls replace with the view of the source.
+ * Since the buffer is frozen, a writer must replace it rather than modify it,
+ * so buffers held by copies, e.g. queued monitor elements, are never changed.
  */
 class epicsShareClass PVCopy :
     public std::tr1::enable_shared_from_this<PVCopy>
@@ -78,6 +110,20 @@ public:
         epics::pvData::PVStructurePtr const &pvMaster,
         epics::pvData::PVStructurePtr const &pvRequest,
         std::string const & structureName);
+    /**
+     * Create a new pvCopy of a master with an update sequence number.
+     * @param pvMaster The top-level structure for which a copy of
+     * an arbitrary subset of the fields in master will be created and managed.
+     * @param pvRequest Selects the set of subfields desired and options for each field.
+     * @param structureName The name for the top level of any PVStructure created.
+     * @param sequenceNumber The sequence number of master, which its owner keeps up to date,
+     * e.g. PVRecord::getSequenceNumberPtr.
+     */
+    static PVCopyPtr create(
+        epics::pvData::PVStructurePtr const &pvMaster,
+        epics::pvData::PVStructurePtr const &pvRequest,
+        std::string const & structureName,
+        SequenceNumberConstPtr const & sequenceNumber);
     virtual ~PVCopy(){}
     /**
      * Get the top-level structure of master
@@ -167,10 +213,40 @@ public:
      *  name is the subField name and value is the subField value.
      */
     epics::pvData::PVStructurePtr getOptions(std::size_t fieldOffset);
+    /**
+     * Should updateMaster move array buffers to master?
+     * If true, after a scalarArray field of master is given the frozen buffer of the copy,
+     * the array in the copy is replaced by an empty array.
+     * The next writer of the copy then fills a fresh buffer instead of
+     * forcing a copy on write of the buffer that master, and its monitors, now share.
+     * The default is false.
+     * @param value The new value.
+     */
+    void setMoveArrays(bool value) {moveArrays = value;}
+    /**
+     * Does updateMaster move array buffers to master?
+     */
+    bool getMoveArrays() const {return moveArrays;}
     /**
      * Is master field requested?
      */
     bool isMasterFieldRequested() const {return requestHasMasterField;}
+    /**
+     * Set the requester that flush calls.
+     * @param requester The requester, only a weak reference is kept.
+     */
+    void setFlushRequester(PVCopyFlushRequesterPtr const & requester) {flushRequester = requester;}
+    /**
+     * Get the update sequence number of master.
+     * @return The sequence number given to create, null if none.
+     */
+    SequenceNumberConstPtr getSequenceNumber() const {return sequenceNumber;}
+    /**
+     * Called by a filter to have a field it held back updated.
+     * Does nothing if there is no flush requester.
+     * @param copyOffset The offset of the field in the copy.
+     */
+    void flush(std::size_t copyOffset);
     /**
      * For debugging.
      */
@@ -188,6 +264,11 @@ private:
     epics::pvData::PVStructurePtr cacheInitStructure;
     epics::pvData::BitSetPtr ignorechangeBitSet;
     bool requestHasMasterField;
+    bool moveArrays;
+    std::vector<CopyNodePtr> volatileNodes;
+    std::vector<CopyNodePtr> conditionNodes;
+    PVCopyFlushRequesterWPtr flushRequester;
+    SequenceNumberConstPtr sequenceNumber;
 
     void traverseMaster(
         CopyNodePtr const &node,
@@ -204,6 +285,12 @@ private:
         epics::pvData::PVFieldPtr const &pvCopy,
         CopyNodePtr const &node,
         epics::pvData::BitSetPtr const &bitSet);
+    void updateVolatile(
+        epics::pvData::PVStructurePtr const & copyPVStructure,
+        epics::pvData::BitSetPtr const & bitSet);
+    bool updateCondition(
+        epics::pvData::PVStructurePtr const & copyPVStructure,
+        epics::pvData::BitSetPtr const & bitSet);
     void updateMasterField(
         CopyNodePtr const & node,
         epics::pvData::PVFieldPtr const & pvCopy,
@@ -0,0 +1,113 @@
+/* pvWherePlugin.h */
+/*
+ * The License for this software can be found in the file LICENSE that is included with the distribution.
+ */
+
+#ifndef PVWHEREPLUGIN_H
+#define PVWHEREPLUGIN_H
+
+#include <string>
+#include <map>
+#include <pv/lock.h>
+#include <pv/pvData.h>
+#include <pv/bitSet.h>
+#include <pv/pvPlugin.h>
+
+#include <shareLib.h>
+
+namespace epics { namespace pvCopy{
+
+class PVWherePlugin;
+class PVWhereFilter;
+class WhereExpression;
+
+typedef std::tr1::shared_ptr<PVWherePlugin> PVWherePluginPtr;
+typedef std::tr1::shared_ptr<PVWhereFilter> PVWhereFilterPtr;
+typedef std::tr1::shared_ptr<WhereExpression> WhereExpressionPtr;
+
+
+/**
+ * @brief  A plugin for a filter that reports updates only while a condition holds.
+ *
+ * A request like <b>field(value[where=alarm.severity>0&&value>10])</b>
+ * reports an update of the copy only if the expression is true for the master.
+ * The expression has the operators <b>|| && ! == != < <= > >=</b> and parentheses,
+ * and its operands are numbers, <b>true</b>, <b>false</b> and the names of
+ * numeric or boolean scalar fields of the master, given from the top of the record.
+ * An operand that is not compared is true if it is not zero.
+ * Integer fields, true, false and numbers with only a sign and digits are integers.
+ * Two integers are compared exactly, also 64 bit ones, other operands as double.
+ * Changes of a suppressed update are reported with the next update that is not.
+ * The expression is compiled when the request is created.
+ */
+class epicsShareClass PVWherePlugin : public PVPlugin
+{
+private:
+    PVWherePlugin();
+public:
+    POINTER_DEFINITIONS(PVWherePlugin);
+    virtual ~PVWherePlugin();
+    /**
+     * Factory
+     */
+    static void create();
+    /**
+     * Create a PVFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param pvCopy The PVCopy to which the PVFilter will be attached.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached
+     * @return The PVFilter.
+     * Null is returned if master or requestValue is not appropriate for the plugin.
+     */
+    virtual PVFilterPtr create(
+         const std::string & requestValue,
+         const PVCopyPtr & pvCopy,
+         const epics::pvData::PVFieldPtr & master);
+};
+
+/**
+ * @brief  A filter that clears the bitSet of an update if its condition is false.
+ */
+class epicsShareClass PVWhereFilter : public PVFilter
+{
+private:
+    WhereExpressionPtr expression;
+    // the changes of suppressed updates
+    epics::pvData::BitSet held;
+
+    PVWhereFilter(WhereExpressionPtr const & expression);
+public:
+    POINTER_DEFINITIONS(PVWhereFilter);
+    virtual ~PVWhereFilter();
+    /**
+     * Create a PVWhereFilter.
+     * @param requestValue The value part of a name=value request option.
+     * @param master The field in the master PVStructure to which the PVFilter will be attached.
+     * @return The PVFilter.
+     * A null is returned if requestValue is not a valid expression for the master.
+     */
+    static PVWhereFilterPtr create(
+        const std::string & requestValue,
+        const epics::pvData::PVFieldPtr & master);
+    /**
+     * Perform a filter operation
+     * @param pvCopy The field in the copy PVStructure.
+     * @param bitSet A bitSet for copyPVStructure.
+     * @param toCopy (true,false) means copy (from master to copy,from copy to master)
+     * @return if filter (modified, did not modify) destination.
+     */
+    bool filter(const epics::pvData::PVFieldPtr & pvCopy,const epics::pvData::BitSetPtr & bitSet,bool toCopy);
+    /**
+     * Get the filter name.
+     * @return The name.
+     */
+    std::string getName();
+    /**
+     * The filter decides if an update is reported.
+     * @return true
+     */
+    virtual bool isCondition() {return true;}
+};
+
+}}
+#endif  /* PVWHEREPLUGIN_H */
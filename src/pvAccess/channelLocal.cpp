@@ -267,7 +267,8 @@ ChannelGetLocalPtr ChannelGetLocal::create(
     PVCopyPtr pvCopy = PVCopy::create(
         pvRecord->getPVRecordStructure()->getPVStructure(),
         pvRequest,
-        "");
+        "",
+        pvRecord->getSequenceNumberPtr());
     if(!pvCopy) {
         Status status(
             Status::STATUSTYPE_ERROR,
@@ -437,7 +438,8 @@ ChannelPutLocalPtr ChannelPutLocal::create(
     PVCopyPtr pvCopy = PVCopy::create(
         pvRecord->getPVRecordStructure()->getPVStructure(),
         pvRequest,
-        "");
+        "",
+        pvRecord->getSequenceNumberPtr());
     if(!pvCopy) {
         Status status(
             Status::STATUSTYPE_ERROR,
@@ -548,6 +550,7 @@ void ChannelPutLocal::put(
         {
             epicsGuard <PVRecord> guard(*pvr);
             pvr->beginGroupPut();
+            pvCopy->setMoveArrays(pvr->getArrayReplace());
             pvCopy->updateMaster(pvStructure, bitSet);
             if(callProcess) {
                  pvr->process();
@@ -633,11 +636,13 @@ ChannelPutGetLocalPtr ChannelPutGetLocal::create(
     PVCopyPtr pvPutCopy = PVCopy::create(
         pvRecord->getPVRecordStructure()->getPVStructure(),
         pvRequest,
-        "putField");
+        "putField",
+        pvRecord->getSequenceNumberPtr());
     PVCopyPtr pvGetCopy = PVCopy::create(
         pvRecord->getPVRecordStructure()->getPVStructure(),
         pvRequest,
-        "getField");
+        "getField",
+        pvRecord->getSequenceNumberPtr());
     if(!pvPutCopy || !pvGetCopy) {
         Status status(
             Status::STATUSTYPE_ERROR,
@@ -715,6 +720,7 @@ void ChannelPutGetLocal::putGet(
         {
             epicsGuard <PVRecord> guard(*pvr);
             pvr->beginGroupPut();
+            pvPutCopy->setMoveArrays(pvr->getArrayReplace());
             pvPutCopy->updateMaster(pvPutStructure, putBitSet);
             if(callProcess) pvr->process();
             getBitSet->clear();
@@ -1267,11 +1273,13 @@ void ChannelArrayLocal::setLength(size_t length)
 ChannelLocal::ChannelLocal(
     ChannelProviderLocalPtr const & provider,
     ChannelRequester::shared_pointer const & requester,
-    PVRecordPtr const & pvRecord)
+    PVRecordPtr const & pvRecord,
+    short priority)
 :
     requester(requester),
     provider(provider),
     pvRecord(pvRecord),
+    priority(priority),
     asLevel(pvRecord->getAsLevel()),
     asGroup(getAsGroup(pvRecord)),
     asUser(getAsUser(requester)),
@@ -1608,7 +1616,8 @@ Monitor::shared_pointer ChannelLocal::createMonitor(
     MonitorPtr monitor = createMonitorLocal(
             pvr,
             monitorRequester,
-            pvRequest);
+            pvRequest,
+            priority);
     return monitor;
 }
 
@@ -157,7 +157,7 @@ Channel::shared_pointer ChannelProviderLocal::createChannel(
         PVRecordPtr pvRecord = pvdb->findRecord(channelName);
         if(pvRecord) {
             channel = ChannelLocalPtr(new ChannelLocal(
-                shared_from_this(),channelRequester,pvRecord));
+                shared_from_this(),channelRequester,pvRecord,priority));
             pvRecord->addPVRecordClient(channel);
        } else {
             status = Status::error("pv not found");
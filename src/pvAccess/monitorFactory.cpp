@@ -10,12 +10,22 @@
  */
 
 #include <sstream>
+#include <deque>
+#include <list>
+#include <map>
 
 #include <epicsGuard.h>
+#include <epicsAtomic.h>
+#include <epicsExit.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
 #include <pv/thread.h>
+#include <pv/event.h>
+#include <pv/timer.h>
 #include <pv/bitSetUtil.h>
 #include <pv/pvData.h>
 #include <pv/pvAccess.h>
+#include <pv/createRequest.h>
 #include <pv/pvTimeStamp.h>
 #include <pv/rpcService.h>
 #include <pv/serverContext.h>
@@ -47,97 +57,871 @@ static Status alreadyStartedStatus(Status::STATUSTYPE_ERROR,"already started");
 static Status notStartedStatus(Status::STATUSTYPE_ERROR,"not started");
 static Status deletedStatus(Status::STATUSTYPE_ERROR,"record is deleted");
 
+class SharedElementPool;
+typedef std::tr1::shared_ptr<SharedElementPool> SharedElementPoolPtr;
+typedef std::map<string,std::tr1::weak_ptr<SharedElementPool> > SharedElementPoolMap;
+
+// the pools of record._options.sharedPool=true by structure
+static SharedElementPoolMap sharedElementPoolMap;
+static Mutex sharedElementPoolMapMutex;
+
+/*
+ * Monitor elements shared by all monitors with record._options.sharedPool=true
+ * whose elements have the same structure.
+ * A queue borrows an element when the producer fills it and returns it
+ * when the client releases it, so an idle monitor only holds its active element.
+ * Spare elements are kept up to the number lent beyond one per user,
+ * i.e. the elements queued or held by clients, but at least minSpare.
+ * Called by the producers and consumers of many monitors, so all methods lock.
+ */
+class SharedElementPool
+{
+private:
+    enum {minSpare = 16};
+    Mutex mutex;
+    StructureConstPtr structure;
+    MonitorElementPtrArray spares;
+    size_t numberUsers;
+    size_t numberLent;
+
+    SharedElementPool(StructureConstPtr const & structure)
+    : structure(structure),
+      numberUsers(0),
+      numberLent(0)
+    {}
+
+    // caller must hold mutex
+    size_t maxSpare() const
+    {
+        size_t inFlight = numberLent>numberUsers ? numberLent - numberUsers : 0;
+        return inFlight>minSpare ? inFlight : minSpare;
+    }
+public:
+    POINTER_DEFINITIONS(SharedElementPool);
+
+    // The pool for structure, the caller uses it until it calls removeUser.
+    static SharedElementPoolPtr getPool(StructureConstPtr const & structure)
+    {
+        std::ostringstream key;
+        key << *structure;
+        SharedElementPoolPtr pool;
+        {
+            Lock xx(sharedElementPoolMapMutex);
+            SharedElementPoolMap::iterator iter = sharedElementPoolMap.begin();
+            while(iter!=sharedElementPoolMap.end()) {
+                if(iter->second.expired()) {
+                    sharedElementPoolMap.erase(iter++);
+                } else {
+                    ++iter;
+                }
+            }
+            pool = sharedElementPoolMap[key.str()].lock();
+            if(!pool) {
+                pool = SharedElementPoolPtr(new SharedElementPool(structure));
+                sharedElementPoolMap[key.str()] = pool;
+            }
+        }
+        Lock xx(pool->mutex);
+        ++pool->numberUsers;
+        return pool;
+    }
+
+    // A user stops, numberLost elements it borrowed are not returned.
+    void removeUser(size_t numberLost)
+    {
+        Lock xx(mutex);
+        --numberUsers;
+        numberLent -= numberLost;
+        if(spares.size()>maxSpare()) spares.resize(maxSpare());
+    }
+
+    MonitorElementPtr get()
+    {
+        MonitorElementPtr element;
+        {
+            Lock xx(mutex);
+            ++numberLent;
+            if(!spares.empty()) {
+                element.swap(spares.back());
+                spares.pop_back();
+            }
+        }
+        if(!element) {
+            return MonitorElementPtr(new MonitorElement(
+                getPVDataCreate()->createPVStructure(structure)));
+        }
+        element->changedBitSet->clear();
+        element->overrunBitSet->clear();
+        return element;
+    }
+
+    void put(MonitorElementPtr const & element)
+    {
+        Lock xx(mutex);
+        --numberLent;
+        if(spares.size()<maxSpare()) spares.push_back(element);
+    }
+};
+
 class MonitorElementQueue;
 typedef std::tr1::shared_ptr<MonitorElementQueue> MonitorElementQueuePtr;
 
+/*
+ * A bounded single producer, single consumer queue of monitor elements.
+ *
+ * The producer is the thread that holds the record lock, i.e. the one that
+ * calls releaseActiveElement. It calls getFree, setUsed, dropOldest,
+ * addElement and removeFree.
+ * The consumer is the thread that calls poll and release. It calls getUsed and releaseUsed.
+ * Element i of the queue is elements[i]. The indices of the elements move
+ * between two rings: used (producer to consumer) and free (consumer to producer).
+ * Each ring position is written by only one side, except the tail of the used ring,
+ * which getUsed and dropOldest both advance with compare and swap.
+ * They read the slot before advancing the tail, so a slot the producer has since
+ * reused makes the compare and swap fail.
+ * Ring positions only increase and position i refers to slot i%capacity.
+ * A ring never holds more elements than exist, so a slot is never written
+ * while the other side may still read it.
+ * The positions written by each side are on separate cache lines.
+ * Each element carries a time: setUsed stores the time the element was queued,
+ * getUsed returns it and stores the time it was polled, which releaseUsed returns.
+ * A queue created with a lender holds elements only while they are in use:
+ * all capacity slots exist, getFree borrows an element for an empty slot
+ * and releaseUsed returns it, each while it owns the slot.
+ */
 class  MonitorElementQueue
 {
 private:
+    enum {cacheLineSize = 64};
+    typedef std::vector<size_t> IndexArray;
+    // null if element i does not exist or, with a lender, is not borrowed;
+    // written by the side that owns slot i
     MonitorElementPtrArray elements;
-    // TODO use size_t instead
-    int size;
-    int numberFree;
-    int numberUsed;
-    int nextGetFree;
-    int nextSetUsed;
-    int nextGetUsed;
-    int nextReleaseUsed;
+    size_t capacity;
+    // written by producer, read by getSize
+    size_t size;
+    SharedElementPoolPtr lender;
+    // the number of borrowed elements, written by both sides
+    size_t numberBorrowed;
+    IndexArray usedRing;
+    IndexArray freeRing;
+    std::vector<epicsUInt64> times;
+    char pad0[cacheLineSize];
+    // written by producer
+    size_t usedHead;
+    size_t freeTail;
+    // returned by getFree, dropOldest or addElement but not yet passed to setUsed
+    IndexArray pending;
+    size_t pendingHead;
+    size_t pendingTail;
+    char pad1[cacheLineSize];
+    // written by consumer
+    size_t freeHead;
+    // returned by getUsed but not yet passed to releaseUsed
+    IndexArray outstanding;
+    size_t outstandingHead;
+    size_t outstandingTail;
+    char pad2[cacheLineSize];
+    // advanced by both sides
+    size_t usedTail;
+    char pad3[cacheLineSize];
+
+    bool takeUsed(size_t & index)
+    {
+        while(true) {
+            size_t tail = epicsAtomicGetSizeT(&usedTail);
+            if(tail==epicsAtomicGetSizeT(&usedHead)) return false;
+            epicsAtomicReadMemoryBarrier();
+            index = epicsAtomicGetSizeT(&usedRing[tail % capacity]);
+            if(epicsAtomicCmpAndSwapSizeT(&usedTail,tail,tail + 1)==tail) return true;
+        }
+    }
+
+    bool takeFree(size_t & index)
+    {
+        size_t head = epicsAtomicGetSizeT(&freeHead);
+        if(freeTail==head) return false;
+        epicsAtomicReadMemoryBarrier();
+        index = freeRing[freeTail++ % capacity];
+        return true;
+    }
 public:
     POINTER_DEFINITIONS(MonitorElementQueue);
 
-    MonitorElementQueue(std::vector<MonitorElementPtr> monitorElementArray)
+    MonitorElementQueue(std::vector<MonitorElementPtr> monitorElementArray,size_t capacity)
     :  elements(monitorElementArray),
+       capacity(capacity),
        size(monitorElementArray.size()),
-       numberFree(size),
-       numberUsed(0),
-       nextGetFree(0),
-       nextSetUsed(0),
-       nextGetUsed(0),
-       nextReleaseUsed(0)
+       numberBorrowed(0),
+       usedRing(capacity),
+       freeRing(capacity),
+       times(capacity,0),
+       usedHead(0),
+       freeTail(0),
+       pending(capacity),
+       pendingHead(0),
+       pendingTail(0),
+       freeHead(0),
+       outstanding(capacity),
+       outstandingHead(0),
+       outstandingTail(0),
+       usedTail(0)
     {
+        if(size>capacity) throw std::logic_error("queue capacity too small");
+        elements.resize(capacity);
+        clear();
     }
 
-    virtual ~MonitorElementQueue() {}
+    MonitorElementQueue(SharedElementPoolPtr const & lender,size_t capacity)
+    :  elements(capacity),
+       capacity(capacity),
+       size(capacity),
+       lender(lender),
+       numberBorrowed(0),
+       usedRing(capacity),
+       freeRing(capacity),
+       times(capacity,0),
+       usedHead(0),
+       freeTail(0),
+       pending(capacity),
+       pendingHead(0),
+       pendingTail(0),
+       freeHead(0),
+       outstanding(capacity),
+       outstandingHead(0),
+       outstandingTail(0),
+       usedTail(0)
+    {
+        clear();
+    }
+
+    virtual ~MonitorElementQueue()
+    {
+        if(lender) lender->removeUser(numberBorrowed);
+    }
 
+    // Only called while neither producer nor consumer is active.
     void clear()
     {
-        numberFree = size;
-        numberUsed = 0;
-        nextGetFree = 0;
-        nextSetUsed = 0;
-        nextGetUsed = 0;
-        nextReleaseUsed = 0;
+        usedHead = usedTail = 0;
+        pendingHead = pendingTail = 0;
+        outstandingHead = outstandingTail = 0;
+        freeTail = 0;
+        freeHead = 0;
+        for(size_t i=0; i<capacity; ++i) {
+            if(lender && elements[i]) {
+                lender->put(elements[i]);
+                elements[i].reset();
+            }
+            if(lender || elements[i]) freeRing[freeHead++] = i;
+        }
+        numberBorrowed = 0;
+        epicsAtomicWriteMemoryBarrier();
+    }
+
+    size_t getSize() const { return epicsAtomicGetSizeT(&size);}
+
+    // The number of elements that currently exist.
+    size_t getNumberElements() const
+    {
+        if(lender) return epicsAtomicGetSizeT(&numberBorrowed);
+        return epicsAtomicGetSizeT(&size);
+    }
+
+    size_t getCapacity() const { return capacity;}
+
+    // True if getFree would return an element.
+    // Without the record lock it is only a hint, getFree decides.
+    bool hasFree() const
+    {
+        return epicsAtomicGetSizeT(&freeHead)!=freeTail;
+    }
+
+    // The number of elements waiting for the consumer.
+    size_t getNumberUsed() const
+    {
+        size_t tail = epicsAtomicGetSizeT(&usedTail);
+        return epicsAtomicGetSizeT(&usedHead) - tail;
     }
 
     MonitorElementPtr getFree()
     {
-        if(numberFree==0) return MonitorElementPtr();
-        numberFree--;
-        int ind = nextGetFree;
-        MonitorElementPtr queueElement = elements[nextGetFree++];
-        if(nextGetFree>=size) nextGetFree = 0;
-        return elements[ind];
+        size_t index;
+        if(!takeFree(index)) return MonitorElementPtr();
+        pending[pendingHead++ % capacity] = index;
+        if(!elements[index]) {
+            elements[index] = lender->get();
+            epicsAtomicIncrSizeT(&numberBorrowed);
+        }
+        return elements[index];
+    }
+
+    // Add a new element, the caller uses it like one returned by getFree.
+    void addElement(MonitorElementPtr const &element)
+    {
+        if(size==capacity) throw std::logic_error("queue is full");
+        size_t index = 0;
+        while(elements[index]) ++index;
+        elements[index] = element;
+        epicsAtomicSetSizeT(&size,size + 1);
+        pending[pendingHead++ % capacity] = index;
     }
 
-    void setUsed(MonitorElementPtr const &element)
+    // Remove a free element, returns null if none is free.
+    MonitorElementPtr removeFree()
     {
-       if(element!=elements[nextSetUsed++]) {
-           throw std::logic_error("not correct queueElement");
+        size_t index;
+        if(!takeFree(index)) return MonitorElementPtr();
+        MonitorElementPtr element;
+        element.swap(elements[index]);
+        epicsAtomicSetSizeT(&size,size - 1);
+        return element;
+    }
+
+    // Take back the oldest element not yet returned by getUsed.
+    MonitorElementPtr dropOldest()
+    {
+        size_t index;
+        if(!takeUsed(index)) return MonitorElementPtr();
+        pending[pendingHead++ % capacity] = index;
+        return elements[index];
+    }
+
+    void setUsed(MonitorElementPtr const &element,epicsUInt64 queuedTime)
+    {
+        if(pendingTail==pendingHead
+        || element!=elements[pending[pendingTail % capacity]]) {
+            throw std::logic_error("not correct queueElement");
         }
-        numberUsed++;
-        if(nextSetUsed>=size) nextSetUsed = 0;
+        size_t index = pending[pendingTail++ % capacity];
+        times[index] = queuedTime;
+        epicsAtomicSetSizeT(&usedRing[usedHead % capacity],index);
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&usedHead,usedHead + 1);
     }
 
-    MonitorElementPtr getUsed()
+    MonitorElementPtr getUsed(epicsUInt64 polledTime,epicsUInt64 & queuedTime)
     {
-        if(numberUsed==0) return MonitorElementPtr();
-        int ind = nextGetUsed;
-        MonitorElementPtr queueElement = elements[nextGetUsed++];
-        if(nextGetUsed>=size) nextGetUsed = 0;
-        return elements[ind];
+        size_t index;
+        if(!takeUsed(index)) return MonitorElementPtr();
+        outstanding[outstandingHead++ % capacity] = index;
+        queuedTime = times[index];
+        times[index] = polledTime;
+        return elements[index];
     }
-    void releaseUsed(MonitorElementPtr const &element)
+
+    void releaseUsed(MonitorElementPtr const &element,epicsUInt64 & polledTime)
     {
-        if(element!=elements[nextReleaseUsed++]) {
+        if(outstandingTail==outstandingHead
+        || element!=elements[outstanding[outstandingTail % capacity]]) {
             throw std::logic_error(
                "not queueElement returned by last call to getUsed");
         }
-        if(nextReleaseUsed>=size) nextReleaseUsed = 0;
-        numberUsed--;
-        numberFree++;
+        size_t index = outstanding[outstandingTail++ % capacity];
+        polledTime = times[index];
+        MonitorElementPtr borrowed;
+        if(lender) borrowed.swap(elements[index]);
+        freeRing[freeHead % capacity] = index;
+        epicsAtomicWriteMemoryBarrier();
+        epicsAtomicSetSizeT(&freeHead,freeHead + 1);
+        if(borrowed) {
+            lender->put(borrowed);
+            epicsAtomicDecrSizeT(&numberBorrowed);
+        }
+    }
+};
+
+class MonitorElementPool;
+typedef std::tr1::shared_ptr<MonitorElementPool> MonitorElementPoolPtr;
+
+/*
+ * Spare monitor elements of one monitor.
+ * An adaptive queue returns elements here when it shrinks and takes them
+ * back when it grows, so a PVStructure is only created when no spare is left.
+ * At most maxSpare elements are kept, the rest are freed.
+ * Only used by the producer.
+ */
+class MonitorElementPool
+{
+private:
+    StructureConstPtr structure;
+    size_t maxSpare;
+    MonitorElementPtrArray spares;
+public:
+    POINTER_DEFINITIONS(MonitorElementPool);
+
+    MonitorElementPool(StructureConstPtr const & structure,size_t maxSpare)
+    : structure(structure),
+      maxSpare(maxSpare)
+    {
+        spares.reserve(maxSpare);
+    }
+
+    MonitorElementPtr get()
+    {
+        if(spares.empty()) {
+            return MonitorElementPtr(new MonitorElement(
+                getPVDataCreate()->createPVStructure(structure)));
+        }
+        MonitorElementPtr element;
+        element.swap(spares.back());
+        spares.pop_back();
+        return element;
+    }
+
+    void put(MonitorElementPtr const & element)
+    {
+        if(spares.size()<maxSpare) spares.push_back(element);
+    }
+};
+
+class BatchLeaf;
+typedef std::tr1::shared_ptr<BatchLeaf> BatchLeafPtr;
+
+/*
+ * A scalar field of the copy whose successive values are collected
+ * for the array at the same offset of the batch structure, see record._options.batch.
+ */
+class BatchLeaf
+{
+public:
+    POINTER_DEFINITIONS(BatchLeaf);
+    virtual ~BatchLeaf() {}
+    // append the current value of the field
+    virtual void append() = 0;
+    // move the collected values into the array of pvBatch
+    virtual void emit(PVStructurePtr const & pvBatch) = 0;
+};
+
+template<typename T>
+class BatchLeafT : public BatchLeaf
+{
+public:
+    BatchLeafT(PVFieldPtr const & pvField,size_t capacity)
+    : pvScalar(std::tr1::static_pointer_cast<PVScalarValue<T> >(pvField)),
+      offset(pvField->getFieldOffset()),
+      capacity(capacity)
+    {
+        values.reserve(capacity);
+    }
+    virtual void append()
+    {
+        values.push_back(pvScalar->get());
+    }
+    virtual void emit(PVStructurePtr const & pvBatch)
+    {
+        PVValueArray<T> *pvArray = static_cast<PVValueArray<T>*>(pvBatch->getSubField(offset).get());
+        pvArray->replace(freeze(values));
+        values.reserve(capacity);
+    }
+private:
+    std::tr1::shared_ptr<PVScalarValue<T> > pvScalar;
+    size_t offset;
+    size_t capacity;
+    shared_vector<T> values;
+};
+
+// The structure of a copy with each scalar replaced by an array of the same type.
+// Null if the copy has fields other than scalars and structures.
+static StructureConstPtr createBatchStructure(StructureConstPtr const & structure)
+{
+    FieldConstPtrArray const & fields = structure->getFields();
+    FieldConstPtrArray batchFields(fields.size());
+    for(size_t i=0; i<fields.size(); ++i) {
+        Type type = fields[i]->getType();
+        if(type==epics::pvData::structure) {
+            batchFields[i] = createBatchStructure(
+                std::tr1::static_pointer_cast<const Structure>(fields[i]));
+            if(!batchFields[i]) return StructureConstPtr();
+        } else if(type==epics::pvData::scalar) {
+            ScalarType scalarType =
+                std::tr1::static_pointer_cast<const Scalar>(fields[i])->getScalarType();
+            batchFields[i] = getFieldCreate()->createScalarArray(scalarType);
+        } else {
+            return StructureConstPtr();
+        }
+    }
+    return getFieldCreate()->createStructure(structure->getFieldNames(),batchFields);
+}
+
+static void createBatchLeaves(
+    PVStructurePtr const & pvStructure,
+    size_t capacity,
+    std::vector<BatchLeafPtr> & leaves)
+{
+    PVFieldPtrArray const & pvFields = pvStructure->getPVFields();
+    for(size_t i=0; i<pvFields.size(); ++i) {
+        PVFieldPtr const & pvField = pvFields[i];
+        if(pvField->getField()->getType()==epics::pvData::structure) {
+            createBatchLeaves(
+                std::tr1::static_pointer_cast<PVStructure>(pvField),capacity,leaves);
+            continue;
+        }
+        BatchLeafPtr leaf;
+        switch(std::tr1::static_pointer_cast<PVScalar>(pvField)->getScalar()->getScalarType()) {
+        case pvBoolean: leaf.reset(new BatchLeafT<boolean>(pvField,capacity)); break;
+        case pvByte: leaf.reset(new BatchLeafT<int8>(pvField,capacity)); break;
+        case pvShort: leaf.reset(new BatchLeafT<int16>(pvField,capacity)); break;
+        case pvInt: leaf.reset(new BatchLeafT<int32>(pvField,capacity)); break;
+        case pvLong: leaf.reset(new BatchLeafT<int64>(pvField,capacity)); break;
+        case pvUByte: leaf.reset(new BatchLeafT<uint8>(pvField,capacity)); break;
+        case pvUShort: leaf.reset(new BatchLeafT<uint16>(pvField,capacity)); break;
+        case pvUInt: leaf.reset(new BatchLeafT<uint32>(pvField,capacity)); break;
+        case pvULong: leaf.reset(new BatchLeafT<uint64>(pvField,capacity)); break;
+        case pvFloat: leaf.reset(new BatchLeafT<float>(pvField,capacity)); break;
+        case pvDouble: leaf.reset(new BatchLeafT<double>(pvField,capacity)); break;
+        case pvString: leaf.reset(new BatchLeafT<string>(pvField,capacity)); break;
+        }
+        leaves.push_back(leaf);
     }
+}
+
+class ReplayRing;
+typedef std::tr1::shared_ptr<ReplayRing> ReplayRingPtr;
+
+// the rings of records with a monitor that asked for record._options.replay
+static std::list<ReplayRingPtr> replayRingList;
+static Mutex replayRingListMutex;
+
+/*
+ * The last updates of a record for monitors with record._options.replay=N.
+ * There is one ring per record, shared by all its monitors.
+ * Each update is kept as a snapshot of the whole record together with
+ * the record offsets of the fields it changed. Arrays are shared, not copied.
+ * The ring only holds updates made after the first monitor asked for it.
+ * Each update also keeps the record sequence number, so a monitor with
+ * record._options.resume=S can tell whether all updates after S are kept.
+ * The record listener calls and the callers of getNumber and fill hold the record lock.
+ * Each replay or resume monitor is a user of the ring. When the last one is
+ * destroyed the ring stops listening and is removed from replayRingList.
+ */
+class ReplayRing :
+    public PVListener,
+    public std::tr1::enable_shared_from_this<ReplayRing>
+{
+public:
+    POINTER_DEFINITIONS(ReplayRing);
+    enum {maxDepth = 1024, defaultResumeDepth = 16};
+    // The ring of pvRecord, it keeps at least the last depth updates.
+    // Each call adds a user, which must call removeUser when done.
+    static ReplayRingPtr getReplayRing(PVRecordPtr const & pvRecord,size_t depth);
+    void removeUser();
+    virtual ~ReplayRing() {}
+    virtual void detach(PVRecordPtr const & pvRecord) {}
+    // endGroupPut only copies the record into the ring
+    virtual bool isParallelSafe() const {return true;}
+    virtual void dataPut(PVRecordFieldPtr const & pvRecordField);
+    virtual void dataPut(
+        PVRecordStructurePtr const & requested,
+        PVRecordFieldPtr const & pvRecordField);
+    virtual void beginGroupPut(PVRecordPtr const & pvRecord);
+    virtual void endGroupPut(PVRecordPtr const & pvRecord);
+    virtual void unlisten(PVRecordPtr const & pvRecord);
+    size_t getNumber() const { return number;}
+    PVRecordPtr getPVRecord() const { return pvRecord.lock();}
+    // The record sequence number of update i, the oldest is 0.
+    uint64 getSequenceNumber(size_t i) const
+    {
+        return sequenceNumbers[(next + snapshots.size() - number + i) % snapshots.size()];
+    }
+    // All updates with a larger sequence number are kept.
+    uint64 getKeptAfter() const { return keptAfter;}
+    // Find the first kept update after sequenceNumber.
+    // Returns false if an update after sequenceNumber is no longer kept.
+    bool findResume(uint64 sequenceNumber,uint64 current,size_t & first) const;
+    // Copy update i, the oldest is 0, into element, which pvCopy created.
+    void fill(size_t i,PVCopyPtr const & pvCopy,MonitorElementPtr const & element);
+private:
+    ReplayRing(PVRecordPtr const & pvRecord);
+    void setDepth(size_t depth);
+    void addUpdate(uint64 sequenceNumber);
+    std::tr1::weak_ptr<PVRecord> pvRecord;
+    PVStructurePtr pvStructure;
+    PVCopyPtr pvCopy;
+    std::vector<PVStructurePtr> snapshots;
+    std::vector<BitSetPtr> changedBitSets;
+    std::vector<uint64> sequenceNumbers;
+    // the slot of the next update and the number of updates kept
+    size_t next;
+    size_t number;
+    uint64 keptAfter;
+    // the fields changed by the current update
+    BitSetPtr changedBitSet;
+    bool isGroupPut;
+    bool listening;
+    // guarded by replayRingListMutex
+    size_t numberUsers;
 };
 
+ReplayRing::ReplayRing(PVRecordPtr const & pvRecord)
+: pvRecord(pvRecord),
+  pvStructure(pvRecord->getPVRecordStructure()->getPVStructure()),
+  pvCopy(PVCopy::create(pvStructure,CreateRequest::create()->createRequest(""),"")),
+  next(0),
+  number(0),
+  keptAfter(0),
+  changedBitSet(new BitSet(pvStructure->getNumberFields())),
+  isGroupPut(false),
+  listening(false),
+  numberUsers(0)
+{
+}
+
+ReplayRingPtr ReplayRing::getReplayRing(PVRecordPtr const & pvRecord,size_t depth)
+{
+    ReplayRingPtr ring;
+    {
+        Lock xx(replayRingListMutex);
+        std::list<ReplayRingPtr>::iterator iter = replayRingList.begin();
+        while(iter!=replayRingList.end()) {
+            PVRecordPtr record = (*iter)->pvRecord.lock();
+            if(!record) {
+                iter = replayRingList.erase(iter);
+                continue;
+            }
+            if(record==pvRecord) ring = *iter;
+            ++iter;
+        }
+        if(!ring) {
+            ring = ReplayRingPtr(new ReplayRing(pvRecord));
+            replayRingList.push_back(ring);
+        }
+        ++ring->numberUsers;
+    }
+    epicsGuard <PVRecord> guard(*pvRecord);
+    ring->setDepth(depth);
+    if(!ring->listening) {
+        ring->listening = true;
+        ring->keptAfter = pvRecord->getSequenceNumber();
+        pvRecord->addListener(ring,ring->pvCopy);
+    }
+    return ring;
+}
+
+void ReplayRing::removeUser()
+{
+    ReplayRingPtr self(shared_from_this());
+    {
+        Lock xx(replayRingListMutex);
+        if(--numberUsers>0) return;
+        replayRingList.remove(self);
+    }
+    PVRecordPtr record(pvRecord.lock());
+    if(!record) return;
+    epicsGuard <PVRecord> guard(*record);
+    if(!listening) return;
+    listening = false;
+    record->removeListener(self,pvCopy);
+}
+
+void ReplayRing::setDepth(size_t depth)
+{
+    size_t size = snapshots.size();
+    if(depth<=size) return;
+    std::vector<PVStructurePtr> newSnapshots;
+    std::vector<BitSetPtr> newChangedBitSets;
+    std::vector<uint64> newSequenceNumbers;
+    newSnapshots.reserve(depth);
+    newChangedBitSets.reserve(depth);
+    newSequenceNumbers.reserve(depth);
+    // the kept updates move to the start, oldest first
+    for(size_t i=0; i<number; ++i) {
+        size_t slot = (next + size - number + i) % size;
+        newSnapshots.push_back(snapshots[slot]);
+        newChangedBitSets.push_back(changedBitSets[slot]);
+        newSequenceNumbers.push_back(sequenceNumbers[slot]);
+    }
+    while(newSnapshots.size()<depth) {
+        newSnapshots.push_back(getPVDataCreate()->createPVStructure(pvStructure->getStructure()));
+        newChangedBitSets.push_back(BitSetPtr(new BitSet(pvStructure->getNumberFields())));
+        newSequenceNumbers.push_back(0);
+    }
+    snapshots.swap(newSnapshots);
+    changedBitSets.swap(newChangedBitSets);
+    sequenceNumbers.swap(newSequenceNumbers);
+    next = number;
+}
+
+void ReplayRing::addUpdate(uint64 sequenceNumber)
+{
+    if(changedBitSet->nextSetBit(0)<0) return;
+    // the oldest update is overwritten
+    if(number==snapshots.size()) keptAfter = sequenceNumbers[next];
+    snapshots[next]->copyUnchecked(*pvStructure);
+    *changedBitSets[next] = *changedBitSet;
+    sequenceNumbers[next] = sequenceNumber;
+    changedBitSet->clear();
+    next = (next + 1) % snapshots.size();
+    if(number<snapshots.size()) ++number;
+}
+
+// Copies the fields of pvCopyStructure from snapshot, a copy of the master of pvCopy,
+// and sets the bits of the fields that snapshotChanged marks as changed.
+static void fillReplayFields(
+    PVCopyPtr const & pvCopy,
+    PVStructurePtr const & pvCopyStructure,
+    PVStructurePtr const & snapshot,
+    BitSet const & snapshotChanged,
+    BitSet & changed)
+{
+    PVFieldPtrArray const & pvFields = pvCopyStructure->getPVFields();
+    for(size_t i=0; i<pvFields.size(); ++i) {
+        PVFieldPtr const & pvField = pvFields[i];
+        if(pvField->getField()->getType()==epics::pvData::structure) {
+            fillReplayFields(pvCopy,static_pointer_cast<PVStructure>(pvField),
+                snapshot,snapshotChanged,changed);
+            continue;
+        }
+        PVFieldPtr pvMaster = pvCopy->getMasterPVField(pvField->getFieldOffset());
+        PVFieldPtr pvSnapshot = snapshot->getSubField(pvMaster->getFieldOffset());
+        // a plugin may have given the copy a different type
+        if(!pvSnapshot || !(*pvSnapshot->getField()==*pvField->getField())) continue;
+        pvField->copyUnchecked(*pvSnapshot);
+        for(PVField *pvParent = pvMaster.get(); pvParent; pvParent = pvParent->getParent()) {
+            if(snapshotChanged.get(pvParent->getFieldOffset())) {
+                changed.set(pvField->getFieldOffset());
+                break;
+            }
+        }
+    }
+}
+
+bool ReplayRing::findResume(uint64 sequenceNumber,uint64 current,size_t & first) const
+{
+    if(sequenceNumber<keptAfter || sequenceNumber>current) return false;
+    first = number;
+    while(first>0 && getSequenceNumber(first-1)>sequenceNumber) --first;
+    return true;
+}
+
+void ReplayRing::fill(size_t i,PVCopyPtr const & pvCopy,MonitorElementPtr const & element)
+{
+    size_t slot = (next + snapshots.size() - number + i) % snapshots.size();
+    element->changedBitSet->clear();
+    element->overrunBitSet->clear();
+    fillReplayFields(pvCopy,element->pvStructurePtr,
+        snapshots[slot],*changedBitSets[slot],*element->changedBitSet);
+    BitSetUtil::compress(element->changedBitSet,element->pvStructurePtr);
+}
+
+void ReplayRing::dataPut(PVRecordFieldPtr const & pvRecordField)
+{
+    size_t offset = pvRecordField->getPVField()->getFieldOffset();
+    // the master field, the subfields that changed are reported too
+    if(offset==0) return;
+    changedBitSet->set(offset);
+    if(!isGroupPut) addUpdate(pvRecordField->getPVRecord()->getSequenceNumber());
+}
+
+void ReplayRing::dataPut(
+    PVRecordStructurePtr const & requested,
+    PVRecordFieldPtr const & pvRecordField)
+{
+    changedBitSet->set(pvRecordField->getPVField()->getFieldOffset());
+    if(!isGroupPut) addUpdate(pvRecordField->getPVRecord()->getSequenceNumber());
+}
+
+void ReplayRing::beginGroupPut(PVRecordPtr const & pvRecord)
+{
+    isGroupPut = true;
+}
+
+void ReplayRing::endGroupPut(PVRecordPtr const & pvRecord)
+{
+    isGroupPut = false;
+    addUpdate(pvRecord->getSequenceNumber());
+}
+
+void ReplayRing::unlisten(PVRecordPtr const & pvRecord)
+{
+    Lock xx(replayRingListMutex);
+    replayRingList.remove(shared_from_this());
+}
 
 typedef std::tr1::shared_ptr<MonitorRequester> MonitorRequesterPtr;
 
+// one timer thread for the batch periods of all monitors
+static TimerPtr batchTimer;
+static Mutex batchTimerMutex;
+
+static void batchTimerExit(void *)
+{
+    TimerPtr timer;
+    {
+        Lock xx(batchTimerMutex);
+        timer = batchTimer;
+    }
+    if(timer) timer->close();
+}
+
+// Sends the partial batch of a monitor when its batchPeriod expires.
+class BatchTimerCallback :
+    public TimerCallback
+{
+public:
+    POINTER_DEFINITIONS(BatchTimerCallback);
+    explicit BatchTimerCallback(std::tr1::weak_ptr<MonitorLocal> const & monitor)
+    : monitor(monitor) {}
+    virtual ~BatchTimerCallback() {}
+    virtual void callback();
+    virtual void timerStopped() {}
+private:
+    std::tr1::weak_ptr<MonitorLocal> monitor;
+};
+
+class MonitorDispatcher;
+typedef std::tr1::shared_ptr<MonitorDispatcher> MonitorDispatcherPtr;
+typedef std::tr1::shared_ptr<epicsThread> EpicsThreadPtr;
+
+/*
+ * Threads that copy record data into monitor elements and call monitorEvent
+ * for monitors created with record[dispatch=true].
+ * The record put only marks such a monitor as queued; changes made before
+ * a dispatcher thread reaches the monitor are sent in one element.
+ * At exit, or when the dispatcher is destroyed, shutdown stops and joins the
+ * threads and releases the monitors still queued.
+ */
+class MonitorDispatcher :
+    public epicsThreadRunable
+{
+public:
+    POINTER_DEFINITIONS(MonitorDispatcher);
+    static MonitorDispatcherPtr getInstance();
+    virtual ~MonitorDispatcher();
+    void dispatch(MonitorLocalPtr const & monitor);
+    void shutdown();
+    virtual void run();
+private:
+    MonitorDispatcher(size_t numberThreads);
+    std::vector<EpicsThreadPtr> threads;
+    std::deque<MonitorLocalPtr> monitors;
+    bool stopping;
+    Event wakeup;
+    Mutex mutex;
+};
+
+
+// Counts a call of poll or release while it may use the queue.
+class ConsumerCall
+{
+public:
+    explicit ConsumerCall(size_t & number) : number(number) {epicsAtomicIncrSizeT(&number);}
+    ~ConsumerCall() {epicsAtomicDecrSizeT(&number);}
+private:
+    size_t & number;
+};
 
 class MonitorLocal :
     public Monitor,
     public PVListener,
+    public PVCopyFlushRequester,
     public std::tr1::enable_shared_from_this<MonitorLocal>
 {
     enum MonitorState {idle,active,deleted};
+    enum OverflowPolicy {coalesce,dropOldest,blockProducer};
+    // an adaptive queue does not shrink below minQueueSize,
+    // and shrinks by at most one element every shrinkWindow queued elements
+    enum {minQueueSize = 2, shrinkWindow = 100};
 public:
     POINTER_DEFINITIONS(MonitorLocal);
     virtual ~MonitorLocal();
@@ -145,7 +929,12 @@ public:
     virtual Status stop();
     virtual MonitorElementPtr poll();
     virtual void detach(PVRecordPtr const & pvRecord){}
+    virtual int getPriority() const {return priority;}
+    // endGroupPut copies into the element of this monitor and calls monitorEvent,
+    // which does not lock the record
+    virtual bool isParallelSafe() const {return true;}
     virtual void release(MonitorElementPtr const & monitorElement);
+    virtual void reportRemoteQueueStatus(int32 freeElements);
     virtual void dataPut(PVRecordFieldPtr const & pvRecordField);
     virtual void dataPut(
         PVRecordStructurePtr const & requested,
@@ -153,44 +942,168 @@ public:
     virtual void beginGroupPut(PVRecordPtr const & pvRecord);
     virtual void endGroupPut(PVRecordPtr const & pvRecord);
     virtual void unlisten(PVRecordPtr const & pvRecord);
+    virtual void flush(size_t copyOffset);
     MonitorElementPtr getActiveElement();
+    // caller must hold the record lock
     void releaseActiveElement();
+    // called by MonitorDispatcher
+    void dispatchActiveElement();
+    // called by the batch timer
+    void batchPeriodExpired();
     bool init(PVStructurePtr const & pvRequest);
     MonitorLocal(
         MonitorRequester::shared_pointer const & channelMonitorRequester,
-        PVRecordPtr const &pvRecord);
+        PVRecordPtr const &pvRecord,
+        short priority);
     PVCopyPtr getPVCopy() { return pvCopy;}
+    PVRecordPtr getPVRecord() { return pvRecord;}
+    void getStats(MonitorLocalStats & stats) const;
 private:
     MonitorLocalPtr getPtrSelf()
     {
         return shared_from_this();
     }
+    MonitorElementPtr getFreeOnOverflow(bool & dropped);
+    void waitForFree();
+    MonitorElementPtr growQueue();
+    void shrinkQueue();
+    bool queueActiveElement();
+    void activeElementChanged();
+    void notifyRequester();
+    MonitorElementPtr getUsed();
+    bool addBatchSample();
+    void emitBatch();
+    bool replay();
+    static void addLatency(size_t * histogram,epicsUInt64 start,epicsUInt64 end);
     MonitorRequester::weak_pointer monitorRequester;
     PVRecordPtr pvRecord;
+    short priority;
     MonitorState state;
     PVCopyPtr pvCopy;
     MonitorElementQueuePtr queue;
+    // the calls of poll and release in progress, start waits for them
+    size_t numberConsumers;
+    MonitorElementPoolPtr pool;
     MonitorElementPtr activeElement;
     bool isGroupPut;
     bool dataChanged;
+    OverflowPolicy overflowPolicy;
+    double blockTimeout;
+    Event freeEvent;
+    // written by the producer, read by getStats
+    size_t numberCoalesced;
+    size_t numberDropped;
+    size_t numberBlocked;
+    size_t numberTimeouts;
+    // adaptive queue size, only used by the producer
+    bool adaptive;
+    bool grown;
+    size_t numberQueued;
+    size_t usedHighWater;
+    // set while queued in the MonitorDispatcher
+    bool dispatch;
+    int dispatchQueued;
+    // with edgeTrigger monitorEvent is only called when notifyArmed is set
+    bool edgeTrigger;
+    int notifyArmed;
+    size_t numberEvents;
+    size_t numberEventsSkipped;
+    // with pipeline an element is only queued while the client has credits
+    bool pipeline;
+    int initialCredits;
+    int credits;
+    size_t numberDeferred;
+    // with sharedPool elements are borrowed from a pool shared with other monitors
+    bool sharedPool;
+    // the number of past updates queued by start
+    size_t replayDepth;
+    ReplayRingPtr replayRing;
+    // with resume start only queues the updates after resumeSequenceNumber
+    bool resume;
+    uint64 resumeSequenceNumber;
+    // the copy offsets of the fields with the sequence plugin
+    std::vector<size_t> sequenceOffsets;
+    // instrumentation, read by getStats
+    string requesterName;
+    size_t queueHighWater;
+    size_t numberOverrunElements;
+    size_t numberOverrunFields;
+    size_t numberPolled;
+    size_t queueLatency[MonitorLocalStats::numberLatencyBuckets];
+    size_t holdTime[MonitorLocalStats::numberLatencyBuckets];
+    // batch mode, only used by the producer
+    bool batch;
+    size_t batchSize;
+    double batchPeriod;
+    PVStructurePtr batchSample;
+    std::vector<BatchLeafPtr> batchLeaves;
+    BitSetPtr batchChangedBitSet;
+    size_t batchCount;
+    epicsUInt64 batchStart;
+    bool batchFlush;
+    // the timer is scheduled for the current batch
+    BatchTimerCallback::shared_pointer batchTimerCallback;
+    bool batchScheduled;
     Mutex mutex;
-    Mutex queueMutex;
 };
 
 MonitorLocal::MonitorLocal(
     MonitorRequester::shared_pointer const & channelMonitorRequester,
-    PVRecordPtr const &pvRecord)
+    PVRecordPtr const &pvRecord,
+    short priority)
 : monitorRequester(channelMonitorRequester),
   pvRecord(pvRecord),
+  priority(priority),
   state(idle),
+  numberConsumers(0),
   isGroupPut(false),
-  dataChanged(false)
+  dataChanged(false),
+  overflowPolicy(coalesce),
+  blockTimeout(0.01),
+  numberCoalesced(0),
+  numberDropped(0),
+  numberBlocked(0),
+  numberTimeouts(0),
+  adaptive(false),
+  grown(false),
+  numberQueued(0),
+  usedHighWater(0),
+  dispatch(false),
+  dispatchQueued(0),
+  edgeTrigger(false),
+  notifyArmed(1),
+  numberEvents(0),
+  numberEventsSkipped(0),
+  pipeline(false),
+  initialCredits(0),
+  credits(0),
+  numberDeferred(0),
+  sharedPool(false),
+  replayDepth(0),
+  resume(false),
+  resumeSequenceNumber(0),
+  queueHighWater(0),
+  numberOverrunElements(0),
+  numberOverrunFields(0),
+  numberPolled(0),
+  batch(false),
+  batchSize(0),
+  batchPeriod(0.0),
+  batchCount(0),
+  batchStart(0),
+  batchFlush(false),
+  batchScheduled(false)
 {
+    for(size_t i=0; i<MonitorLocalStats::numberLatencyBuckets; ++i) {
+        queueLatency[i] = 0;
+        holdTime[i] = 0;
+    }
 }
 
 MonitorLocal::~MonitorLocal()
 {
 //cout << "MonitorLocal::~MonitorLocal()" << endl;
+    if(replayRing) replayRing->removeUser();
 }
 
 
@@ -208,13 +1121,32 @@ Status MonitorLocal::start()
     pvRecord->addListener(getPtrSelf(),pvCopy);
     epicsGuard <PVRecord> guard(*pvRecord);
     Lock xx(mutex);
-    state = active;
+    // a poll or release that began before stop may still use the queue,
+    // the ones that begin now return since the state is not active
+    while(epicsAtomicGetSizeT(&numberConsumers)!=0) epicsThreadSleep(0.0);
     queue->clear();
     isGroupPut = false;
     activeElement = queue->getFree();
     activeElement->changedBitSet->clear();
     activeElement->overrunBitSet->clear();
+    epicsAtomicSetIntT(&notifyArmed,1);
+    epicsAtomicSetIntT(&credits,initialCredits);
+    bool resumed = false;
+    if(replayRing) resumed = replay();
+    if(resumed) {
+        // the client already has the record up to the replayed updates
+        state = active;
+        if(queue->getNumberUsed()>0) notifyRequester();
+        return Status::Ok;
+    }
     activeElement->changedBitSet->set(0);
+    if(batch) {
+        // the initial element is sent at once
+        batchCount = 0;
+        batchChangedBitSet->clear();
+        batchFlush = true;
+    }
+    state = active;
     releaseActiveElement();
     return Status::Ok;
 }
@@ -230,6 +1162,7 @@ Status MonitorLocal::stop()
         if(state==deleted) return deletedStatus;
         state = idle;
     }
+    freeEvent.signal();
     pvRecord->removeListener(getPtrSelf(),pvCopy);
     return Status::Ok;
 }
@@ -240,11 +1173,37 @@ MonitorElementPtr MonitorLocal::poll()
     {
         cout << "MonitorLocal::poll state  " << state << endl;
     }
-    {
-        Lock xx(queueMutex);
-        if(state!=active) return NULLMonitorElement;
-        return queue->getUsed();
+    ConsumerCall call(numberConsumers);
+    if(state!=active) return NULLMonitorElement;
+    MonitorElementPtr element = getUsed();
+    if(element || !edgeTrigger) return element;
+    // Re-arm, then look again for an element queued before the producer saw the arm.
+    epicsAtomicCmpAndSwapIntT(&notifyArmed,0,1);
+    element = getUsed();
+    if(element) epicsAtomicCmpAndSwapIntT(&notifyArmed,1,0);
+    return element;
+}
+
+MonitorElementPtr MonitorLocal::getUsed()
+{
+    epicsUInt64 now = epicsMonotonicGet();
+    epicsUInt64 queuedTime = 0;
+    MonitorElementPtr element = queue->getUsed(now,queuedTime);
+    if(!element) return element;
+    epicsAtomicIncrSizeT(&numberPolled);
+    addLatency(queueLatency,queuedTime,now);
+    return element;
+}
+
+void MonitorLocal::addLatency(size_t * histogram,epicsUInt64 start,epicsUInt64 end)
+{
+    epicsUInt64 micro = end>start ? (end - start)/1000 : 0;
+    size_t bucket = 0;
+    while(micro>1 && bucket<MonitorLocalStats::numberLatencyBuckets - 1) {
+        micro >>= 1;
+        ++bucket;
     }
+    epicsAtomicIncrSizeT(&histogram[bucket]);
 }
 
 void MonitorLocal::release(MonitorElementPtr const & monitorElement)
@@ -253,11 +1212,105 @@ void MonitorLocal::release(MonitorElementPtr const & monitorElement)
     {
         cout << "MonitorLocal::release state  " << state << endl;
     }
+    ConsumerCall call(numberConsumers);
+    if(state!=active) return;
+    epicsUInt64 polledTime = 0;
+    queue->releaseUsed(monitorElement,polledTime);
+    addLatency(holdTime,polledTime,epicsMonotonicGet());
+    if(overflowPolicy==blockProducer) freeEvent.signal();
+}
+
+void MonitorLocal::reportRemoteQueueStatus(int32 freeElements)
+{
+    if(pvRecord->getTraceLevel()>1)
+    {
+        cout << "MonitorLocal::reportRemoteQueueStatus freeElements " << freeElements << endl;
+    }
+    if(!pipeline || freeElements<=0) return;
+    epicsAtomicAddIntT(&credits,freeElements);
+    if(state!=active) return;
+    // send the changes that accumulated while the client had no credits
+    bool queued = false;
     {
-        Lock xx(queueMutex);
-        if(state!=active) return;
-        queue->releaseUsed(monitorElement);
+        epicsGuard <PVRecord> guard(*pvRecord);
+        if(activeElement->changedBitSet->nextSetBit(0)<0 && batchCount==0) return;
+        queued = queueActiveElement();
     }
+    if(queued) notifyRequester();
+}
+
+MonitorElementPtr MonitorLocal::getFreeOnOverflow(bool & dropped)
+{
+    dropped = false;
+    if(overflowPolicy==dropOldest) {
+        MonitorElementPtr element = queue->dropOldest();
+        if(element) {
+            dropped = true;
+            epicsAtomicIncrSizeT(&numberDropped);
+        }
+        return element;
+    }
+    // with dispatch the dispatcher already waited, without the record lock
+    if(overflowPolicy==blockProducer && !dispatch) {
+        // The record stays locked while waiting, which stalls every writer and
+        // every other monitor of the record; release does not need the lock.
+        epicsAtomicIncrSizeT(&numberBlocked);
+        epicsTime deadline = epicsTime::getCurrent() + blockTimeout;
+        while(true) {
+            MonitorElementPtr element = queue->getFree();
+            if(element) return element;
+            double remaining = deadline - epicsTime::getCurrent();
+            if(remaining<=0.0 || state!=active) break;
+            freeEvent.wait(remaining);
+        }
+        epicsAtomicIncrSizeT(&numberTimeouts);
+    }
+    return NULLMonitorElement;
+}
+
+// Called by the dispatcher before it locks the record.
+// Waits up to blockTimeout for the client to release an element,
+// while the writers and the other monitors of the record go on.
+void MonitorLocal::waitForFree()
+{
+    if(queue->hasFree()) return;
+    if(adaptive && queue->getSize()<queue->getCapacity()) return;
+    epicsAtomicIncrSizeT(&numberBlocked);
+    epicsTime deadline = epicsTime::getCurrent() + blockTimeout;
+    while(!queue->hasFree()) {
+        double remaining = deadline - epicsTime::getCurrent();
+        if(remaining<=0.0 || state!=active) {
+            epicsAtomicIncrSizeT(&numberTimeouts);
+            return;
+        }
+        freeEvent.wait(remaining);
+    }
+}
+
+MonitorElementPtr MonitorLocal::growQueue()
+{
+    if(!adaptive || queue->getSize()>=queue->getCapacity()) return NULLMonitorElement;
+    MonitorElementPtr element = pool->get();
+    queue->addElement(element);
+    grown = true;
+    return element;
+}
+
+// Called after each queued element.
+// Removes a free element if the queue stayed less than half used for a window.
+void MonitorLocal::shrinkQueue()
+{
+    size_t used = queue->getNumberUsed();
+    if(used>usedHighWater) usedHighWater = used;
+    if(++numberQueued<shrinkWindow) return;
+    size_t size = queue->getSize();
+    if(!grown && size>minQueueSize && 2*(usedHighWater + 1)<size) {
+        MonitorElementPtr element = queue->removeFree();
+        if(element) pool->put(element);
+    }
+    numberQueued = 0;
+    usedHighWater = 0;
+    grown = false;
 }
 
 void MonitorLocal::releaseActiveElement()
@@ -266,24 +1319,226 @@ void MonitorLocal::releaseActiveElement()
     {
         cout << "MonitorLocal::releaseActiveElement  state  " << state << endl;
     }
+    if(!queueActiveElement()) return;
+    notifyRequester();
+}
+
+void MonitorLocal::dispatchActiveElement()
+{
+    if(pvRecord->getTraceLevel()>1)
+    {
+        cout << "MonitorLocal::dispatchActiveElement  state  " << state << endl;
+    }
+    if(overflowPolicy==blockProducer) waitForFree();
+    bool queued = false;
     {
-        Lock xx(queueMutex);
-        if(state!=active) return;
+        epicsGuard <PVRecord> guard(*pvRecord);
+        epicsAtomicSetIntT(&dispatchQueued,0);
+        queued = queueActiveElement();
+    }
+    if(!queued) return;
+    notifyRequester();
+}
+
+void MonitorLocal::notifyRequester()
+{
+    // with edgeTrigger only the first element after poll returned null is signaled
+    if(edgeTrigger && epicsAtomicCmpAndSwapIntT(&notifyArmed,1,0)!=1) {
+        epicsAtomicIncrSizeT(&numberEventsSkipped);
+        return;
+    }
+    MonitorRequesterPtr requester = monitorRequester.lock();
+    if(!requester) return;
+    epicsAtomicIncrSizeT(&numberEvents);
+    requester->monitorEvent(getPtrSelf());
+}
+
+// caller must hold the record lock
+void MonitorLocal::activeElementChanged()
+{
+    if(!dispatch) {
+        releaseActiveElement();
+        return;
+    }
+    if(epicsAtomicCmpAndSwapIntT(&dispatchQueued,0,1)!=0) return;
+    MonitorDispatcher::getInstance()->dispatch(getPtrSelf());
+}
+
+// caller must hold the record lock
+// returns true if activeElement was queued for the client
+bool MonitorLocal::queueActiveElement()
+{
+    // The record lock serializes all producers, poll and release do not lock.
+    if(state!=active) return false;
+    // a batch collects every sample, even while the client has no credits
+    if(batch && !addBatchSample()) return false;
+    if(pipeline && epicsAtomicGetIntT(&credits)<=0) {
+        // no copy until the client reports free elements,
+        // changes accumulate in the bitsets of activeElement
+        epicsAtomicIncrSizeT(&numberDeferred);
+        return false;
+    }
+    if(!batch) {
         bool result = pvCopy->updateCopyFromBitSet(activeElement->pvStructurePtr,activeElement->changedBitSet);
-        if(!result) return;
+        if(!result) return false;
+    }
+    bool dropped = false;
+    MonitorElementPtr newActive = queue->getFree();
+    if(!newActive) newActive = growQueue();
+    if(!newActive) newActive = getFreeOnOverflow(dropped);
+    if(!newActive) {
+        // queue is full, the next update is merged into activeElement,
+        // a batch keeps collecting samples
+        epicsAtomicIncrSizeT(&numberCoalesced);
+        return false;
+    }
+    if(batch) emitBatch();
+    BitSetUtil::compress(activeElement->changedBitSet,activeElement->pvStructurePtr);
+    BitSetUtil::compress(activeElement->overrunBitSet,activeElement->pvStructurePtr);
+    if(activeElement->overrunBitSet->nextSetBit(0)>=0) {
+        epicsAtomicIncrSizeT(&numberOverrunElements);
+        epicsAtomicAddSizeT(&numberOverrunFields,activeElement->overrunBitSet->cardinality());
+    }
+    queue->setUsed(activeElement,epicsMonotonicGet());
+    size_t used = queue->getNumberUsed();
+    if(used>queueHighWater) epicsAtomicSetSizeT(&queueHighWater,used);
+    activeElement = newActive;
+    if(dropped) {
+        // The client never sees the dropped element, so the fields it changed
+        // are sent again with the next element and marked as overrun.
+        *activeElement->overrunBitSet |= *activeElement->changedBitSet;
+        // a batch sample is only taken for new changes
+        if(batch) activeElement->changedBitSet->clear();
+    } else {
+        activeElement->changedBitSet->clear();
+        activeElement->overrunBitSet->clear();
+    }
+    if(adaptive) shrinkQueue();
+    if(pipeline) epicsAtomicDecrIntT(&credits);
+    return true;
+}
+
+// caller must hold the record lock
+// Adds the changes since the last sample to the batch,
+// returns true if the batch should be sent.
+bool MonitorLocal::addBatchSample()
+{
+    BitSetPtr const & changedBitSet = activeElement->changedBitSet;
+    if(changedBitSet->nextSetBit(0)>=0) {
+        if(pvCopy->updateCopyFromBitSet(batchSample,changedBitSet)) {
+            if(batchCount==0) {
+                batchStart = epicsMonotonicGet();
+                if(batchPeriod>0.0 && !batchScheduled) {
+                    batchScheduled = true;
+                    batchTimer->scheduleAfterDelay(batchTimerCallback,batchPeriod);
+                }
+            }
+            for(size_t i=0; i<batchLeaves.size(); ++i) batchLeaves[i]->append();
+            ++batchCount;
+            *batchChangedBitSet |= *changedBitSet;
+        }
+        changedBitSet->clear();
+    }
+    if(batchCount==0) return false;
+    if(batchFlush) return true;
+    if(batchSize>0 && batchCount>=batchSize) return true;
+    if(batchPeriod>0.0 && (epicsMonotonicGet() - batchStart)*1e-9>=batchPeriod) return true;
+    return false;
+}
+
+// The copy offsets of the integer fields with the request option sequence=true.
+static void findSequenceFields(PVCopyPtr const & pvCopy,std::vector<size_t> & offsets)
+{
+    PVStructurePtr pvStructure = pvCopy->createPVStructure();
+    for(size_t offset=1; offset<pvStructure->getNumberFields(); ++offset) {
+        PVStructurePtr pvOptions = pvCopy->getOptions(offset);
+        if(!pvOptions) continue;
+        PVStringPtr pvString = pvOptions->getSubField<PVString>("sequence");
+        if(!pvString || pvString->get()!="true") continue;
+        PVScalarPtr pvScalar = pvStructure->getSubField<PVScalar>(offset);
+        if(!pvScalar) continue;
+        ScalarType scalarType = pvScalar->getScalar()->getScalarType();
+        if(ScalarTypeFunc::isInteger(scalarType) || ScalarTypeFunc::isUInteger(scalarType)) {
+            offsets.push_back(offset);
+        }
+    }
+}
+
+// caller must hold the record lock
+// Queues the last replayDepth updates kept by replayRing, the oldest as
+// a complete element. The queue has room for them and the initial element.
+// With resume it queues the updates after resumeSequenceNumber, which then
+// replace the initial element, and returns true. If they are more than
+// replayDepth or some are no longer kept it queues nothing and returns false.
+bool MonitorLocal::replay()
+{
+    size_t number = replayRing->getNumber();
+    size_t first = number>replayDepth ? number - replayDepth : 0;
+    if(resume) {
+        if(!replayRing->findResume(resumeSequenceNumber,pvRecord->getSequenceNumber(),first)) {
+            return false;
+        }
+        if(number - first>replayDepth) return false;
+    }
+    for(size_t i=first; i<number; ++i) {
         MonitorElementPtr newActive = queue->getFree();
-        if(!newActive) return;
-        BitSetUtil::compress(activeElement->changedBitSet,activeElement->pvStructurePtr);
-        BitSetUtil::compress(activeElement->overrunBitSet,activeElement->pvStructurePtr);
-        queue->setUsed(activeElement);
+        if(!newActive) break;
+        replayRing->fill(i,pvCopy,activeElement);
+        PVStructurePtr const & pvStructure = activeElement->pvStructurePtr;
+        for(size_t j=0; j<sequenceOffsets.size(); ++j) {
+            PVScalarPtr pvScalar = static_pointer_cast<PVScalar>(
+                pvStructure->getSubField(sequenceOffsets[j]));
+            pvScalar->putFrom<uint64>(replayRing->getSequenceNumber(i));
+            activeElement->changedBitSet->set(sequenceOffsets[j]);
+        }
+        if(i==first && !resume) {
+            activeElement->changedBitSet->clear();
+            activeElement->changedBitSet->set(0);
+        }
+        queue->setUsed(activeElement,epicsMonotonicGet());
         activeElement = newActive;
         activeElement->changedBitSet->clear();
         activeElement->overrunBitSet->clear();
+        if(pipeline) epicsAtomicDecrIntT(&credits);
     }
-    MonitorRequesterPtr requester = monitorRequester.lock();
-    if(!requester) return;
-    requester->monitorEvent(getPtrSelf());
-    return;
+    return resume;
+}
+
+void BatchTimerCallback::callback()
+{
+    MonitorLocalPtr monitorLocal = monitor.lock();
+    if(monitorLocal) monitorLocal->batchPeriodExpired();
+}
+
+// Sends the batch if its period expired, else waits for the rest of the period.
+void MonitorLocal::batchPeriodExpired()
+{
+    bool queued = false;
+    {
+        epicsGuard <PVRecord> guard(*pvRecord);
+        batchScheduled = false;
+        if(state!=active || batchCount==0) return;
+        double remaining = batchPeriod - (epicsMonotonicGet() - batchStart)*1e-9;
+        if(remaining>0.0) {
+            batchScheduled = true;
+            batchTimer->scheduleAfterDelay(batchTimerCallback,remaining);
+            return;
+        }
+        queued = queueActiveElement();
+    }
+    if(queued) notifyRequester();
+}
+
+// caller must hold the record lock
+void MonitorLocal::emitBatch()
+{
+    for(size_t i=0; i<batchLeaves.size(); ++i) {
+        batchLeaves[i]->emit(activeElement->pvStructurePtr);
+    }
+    *activeElement->changedBitSet = *batchChangedBitSet;
+    batchChangedBitSet->clear();
+    batchCount = 0;
+    batchFlush = false;
 }
 
 void MonitorLocal::dataPut(PVRecordFieldPtr const & pvRecordField)
@@ -310,7 +1565,7 @@ void MonitorLocal::dataPut(PVRecordFieldPtr const & pvRecordField)
         dataChanged = true;
     }
     if(!isGroupPut) {
-        releaseActiveElement();
+        activeElementChanged();
         dataChanged = false;
     }
 }
@@ -339,7 +1594,7 @@ void MonitorLocal::dataPut(
         dataChanged = true;
     }
     if(!isGroupPut) {
-        releaseActiveElement();
+        activeElementChanged();
         dataChanged = false;
     }
 }
@@ -371,7 +1626,27 @@ void MonitorLocal::endGroupPut(PVRecordPtr const & pvRecord)
     }
     if(dataChanged) {
         dataChanged = false;
-        releaseActiveElement();
+        activeElementChanged();
+    }
+}
+
+// called by a filter, e.g. rate, for a change it held back
+void MonitorLocal::flush(size_t copyOffset)
+{
+    if(pvRecord->getTraceLevel()>1)
+    {
+        cout << "MonitorLocal::flush copyOffset " << copyOffset << endl;
+    }
+    epicsGuard <PVRecord> guard(*pvRecord);
+    if(state!=active) return;
+    {
+        Lock xx(mutex);
+        activeElement->changedBitSet->set(copyOffset);
+        dataChanged = true;
+    }
+    if(!isGroupPut) {
+        activeElementChanged();
+        dataChanged = false;
     }
 }
 
@@ -400,6 +1675,7 @@ bool MonitorLocal::init(PVStructurePtr const & pvRequest)
 {
     PVFieldPtr pvField;
     size_t queueSize = 2;
+    size_t maxQueueSize = 0;
     PVStructurePtr pvOptions = pvRequest->getSubField<PVStructure>("record._options");
     MonitorRequesterPtr requester = monitorRequester.lock();
     if(!requester) return false;
@@ -417,12 +1693,138 @@ bool MonitorLocal::init(PVStructurePtr const & pvRequest)
                  return false;
             }
         }
+        pvString  = pvOptions->getSubField<PVString>("maxQueueSize");
+        if(pvString) {
+            int32 size = 0;
+            std::stringstream ss;
+            ss << pvString->get();
+            ss >> size;
+            if(ss.fail() || size<0) {
+                requester->message("maxQueueSize " +pvString->get() + " illegal",errorMessage);
+                return false;
+            }
+            maxQueueSize = size;
+        }
+        pvString  = pvOptions->getSubField<PVString>("dispatch");
+        if(pvString) {
+            string value = pvString->get();
+            if(value=="true") {
+                dispatch = true;
+            } else if(value!="false") {
+                requester->message("dispatch " + value + " illegal",errorMessage);
+                return false;
+            }
+        }
+        pvString  = pvOptions->getSubField<PVString>("notify");
+        if(pvString) {
+            string value = pvString->get();
+            if(value=="edge") {
+                edgeTrigger = true;
+            } else if(value!="all") {
+                requester->message("notify " + value + " illegal",errorMessage);
+                return false;
+            }
+        }
+        pvString  = pvOptions->getSubField<PVString>("pipeline");
+        if(pvString) {
+            string value = pvString->get();
+            if(value=="true") {
+                pipeline = true;
+            } else if(value!="false") {
+                requester->message("pipeline " + value + " illegal",errorMessage);
+                return false;
+            }
+        }
+        pvString  = pvOptions->getSubField<PVString>("sharedPool");
+        if(pvString) {
+            string value = pvString->get();
+            if(value=="true") {
+                sharedPool = true;
+            } else if(value!="false") {
+                requester->message("sharedPool " + value + " illegal",errorMessage);
+                return false;
+            }
+        }
+        pvString  = pvOptions->getSubField<PVString>("replay");
+        if(pvString) {
+            int32 depth = 0;
+            std::stringstream ss;
+            ss << pvString->get();
+            ss >> depth;
+            if(ss.fail() || depth<1 || depth>ReplayRing::maxDepth) {
+                requester->message("replay " +pvString->get() + " illegal",errorMessage);
+                return false;
+            }
+            replayDepth = depth;
+        }
+        pvString  = pvOptions->getSubField<PVString>("resume");
+        if(pvString) {
+            uint64 sequenceNumber = 0;
+            std::stringstream ss;
+            ss << pvString->get();
+            ss >> sequenceNumber;
+            if(ss.fail() || pvString->get().find('-')!=string::npos) {
+                requester->message("resume " +pvString->get() + " illegal",errorMessage);
+                return false;
+            }
+            resume = true;
+            resumeSequenceNumber = sequenceNumber;
+            if(replayDepth==0) replayDepth = ReplayRing::defaultResumeDepth;
+        }
+        pvString  = pvOptions->getSubField<PVString>("batch");
+        if(pvString) {
+            int32 size = 0;
+            std::stringstream ss;
+            ss << pvString->get();
+            ss >> size;
+            if(ss.fail() || size<1) {
+                requester->message("batch " +pvString->get() + " illegal",errorMessage);
+                return false;
+            }
+            batch = true;
+            batchSize = size;
+        }
+        pvString  = pvOptions->getSubField<PVString>("batchPeriod");
+        if(pvString) {
+            std::stringstream ss;
+            ss << pvString->get();
+            ss >> batchPeriod;
+            if(ss.fail() || batchPeriod<=0.0) {
+                requester->message("batchPeriod " +pvString->get() + " illegal",errorMessage);
+                return false;
+            }
+            batch = true;
+        }
+        pvString  = pvOptions->getSubField<PVString>("overflow");
+        if(pvString) {
+            string value = pvString->get();
+            if(value=="coalesce") {
+                overflowPolicy = coalesce;
+            } else if(value=="dropOldest") {
+                overflowPolicy = dropOldest;
+            } else if(value=="block") {
+                overflowPolicy = blockProducer;
+            } else {
+                requester->message("overflow " + value + " illegal",errorMessage);
+                return false;
+            }
+        }
+        pvString  = pvOptions->getSubField<PVString>("blockTimeout");
+        if(pvString) {
+            std::stringstream ss;
+            ss << pvString->get();
+            ss >> blockTimeout;
+            if(ss.fail() || blockTimeout<0.0) {
+                requester->message("blockTimeout " +pvString->get() + " illegal",errorMessage);
+                return false;
+            }
+        }
     }
     pvField = pvRequest->getSubField("field");
     if(!pvField) {
         pvCopy = PVCopy::create(
             pvRecord->getPVRecordStructure()->getPVStructure(),
-            pvRequest,"");
+            pvRequest,"",pvRecord->getSequenceNumberPtr());
         if(!pvCopy) {
             requester->message("illegal pvRequest",errorMessage);
             return false;
@@ -434,36 +1836,300 @@ bool MonitorLocal::init(PVStructurePtr const & pvRequest)
         }
         pvCopy = PVCopy::create(
             pvRecord->getPVRecordStructure()->getPVStructure(),
-            pvRequest,"field");
+            pvRequest,"field",pvRecord->getSequenceNumberPtr());
         if(!pvCopy) {
             requester->message("illegal pvRequest",errorMessage);
             return false;
         }
     }
-    if(queueSize<2) queueSize = 2;
-    std::vector<MonitorElementPtr> monitorElementArray;
-    monitorElementArray.reserve(queueSize);
-    for(size_t i=0; i<queueSize; i++) {
-         PVStructurePtr pvStructure = pvCopy->createPVStructure();
-         MonitorElementPtr monitorElement(
-             new MonitorElement(pvStructure));
-         monitorElementArray.push_back(monitorElement);
+    pvCopy->setFlushRequester(getPtrSelf());
+    if(queueSize<minQueueSize) queueSize = minQueueSize;
+    // room for the replayed updates, the initial element and the active element
+    if(queueSize<replayDepth + 2) queueSize = replayDepth + 2;
+    // a shared pool queue only holds the elements in use,
+    // so it has maxQueueSize slots and no need to adapt
+    if(sharedPool && maxQueueSize>queueSize) queueSize = maxQueueSize;
+    // a pipeline client starts with one credit per element of its queue
+    initialCredits = queueSize;
+    // maxQueueSize larger than queueSize makes the queue size adaptive
+    adaptive = maxQueueSize>queueSize;
+    if(!adaptive) maxQueueSize = queueSize;
+    StructureConstPtr elementStructure = pvCopy->getStructure();
+    if(batch) {
+        if(replayDepth>0) {
+            requester->message("replay is not supported with batch",errorMessage);
+            return false;
+        }
+        elementStructure = createBatchStructure(elementStructure);
+        if(!elementStructure) {
+            requester->message("batch requires a request of scalar fields",errorMessage);
+            return false;
+        }
+        batchSample = pvCopy->createPVStructure();
+        createBatchLeaves(batchSample,batchSize>0 ? batchSize : 64,batchLeaves);
+        batchChangedBitSet = BitSetPtr(new BitSet(batchSample->getNumberFields()));
+        if(batchPeriod>0.0) {
+            {
+                Lock xx(batchTimerMutex);
+                if(!batchTimer) {
+                    batchTimer = TimerPtr(new Timer("pvDatabaseBatch",lowPriority));
+                    epicsAtExit(batchTimerExit,0);
+                }
+            }
+            batchTimerCallback = BatchTimerCallback::shared_pointer(
+                new BatchTimerCallback(getPtrSelf()));
+        }
+    }
+    if(sharedPool) {
+        queue = MonitorElementQueuePtr(new MonitorElementQueue(
+            SharedElementPool::getPool(elementStructure),queueSize));
+    } else {
+        pool = MonitorElementPoolPtr(new MonitorElementPool(elementStructure,queueSize));
+        std::vector<MonitorElementPtr> monitorElementArray;
+        monitorElementArray.reserve(queueSize);
+        for(size_t i=0; i<queueSize; i++) {
+             monitorElementArray.push_back(pool->get());
+        }
+        queue = MonitorElementQueuePtr(
+            new MonitorElementQueue(monitorElementArray,maxQueueSize));
     }
-    queue = MonitorElementQueuePtr(new MonitorElementQueue(monitorElementArray));
+    if(replayDepth>0) {
+        replayRing = ReplayRing::getReplayRing(pvRecord,replayDepth);
+        findSequenceFields(pvCopy,sequenceOffsets);
+    }
+    requesterName = requester->getRequesterName();
     requester->monitorConnect(
         Status::Ok,
         getPtrSelf(),
-        pvCopy->getStructure());
+        elementStructure);
+    return true;
+}
+
+static MonitorDispatcherPtr monitorDispatcher;
+static Mutex monitorDispatcherMutex;
+
+static void monitorDispatcherExit(void *)
+{
+    MonitorDispatcherPtr dispatcher;
+    {
+        Lock xx(monitorDispatcherMutex);
+        dispatcher = monitorDispatcher;
+    }
+    if(dispatcher) dispatcher->shutdown();
+}
+
+MonitorDispatcherPtr MonitorDispatcher::getInstance()
+{
+    Lock xx(monitorDispatcherMutex);
+    if(!monitorDispatcher) {
+        size_t numberThreads = epicsThreadGetCPUs();
+        if(numberThreads<1) numberThreads = 1;
+        if(numberThreads>4) numberThreads = 4;
+        monitorDispatcher = MonitorDispatcherPtr(new MonitorDispatcher(numberThreads));
+        epicsAtExit(monitorDispatcherExit,0);
+    }
+    return monitorDispatcher;
+}
+
+MonitorDispatcher::MonitorDispatcher(size_t numberThreads)
+: stopping(false)
+{
+    threads.reserve(numberThreads);
+    for(size_t i=0; i<numberThreads; ++i) {
+        threads.push_back(EpicsThreadPtr(new epicsThread(
+            *this,
+            "monitorDispatcher",
+            epicsThreadGetStackSize(epicsThreadStackSmall),
+            epicsThreadPriorityMedium)));
+        threads.back()->start();
+    }
+}
+
+MonitorDispatcher::~MonitorDispatcher()
+{
+    shutdown();
+}
+
+void MonitorDispatcher::shutdown()
+{
+    {
+        Lock xx(mutex);
+        if(stopping) return;
+        stopping = true;
+        monitors.clear();
+    }
+    // each thread that stops wakes the next one
+    wakeup.signal();
+    for(size_t i=0; i<threads.size(); ++i) {
+        if(!threads[i]->isCurrentThread()) threads[i]->exitWait();
+    }
+}
+
+void MonitorDispatcher::dispatch(MonitorLocalPtr const & monitor)
+{
+    {
+        Lock xx(mutex);
+        if(stopping) return;
+        // monitors with a higher priority are dispatched first
+        std::deque<MonitorLocalPtr>::iterator iter = monitors.end();
+        while(iter!=monitors.begin()
+        && (*(iter - 1))->getPriority()<monitor->getPriority()) --iter;
+        monitors.insert(iter,monitor);
+    }
+    wakeup.signal();
+}
+
+void MonitorDispatcher::run()
+{
+    while(true) {
+        wakeup.wait();
+        while(true) {
+            MonitorLocalPtr monitor;
+            bool more = false;
+            {
+                Lock xx(mutex);
+                if(stopping) {
+                    wakeup.signal();
+                    return;
+                }
+                if(monitors.empty()) break;
+                monitor = monitors.front();
+                monitors.pop_front();
+                more = !monitors.empty();
+            }
+            // let another thread take the next monitor
+            if(more) wakeup.signal();
+            monitor->dispatchActiveElement();
+        }
+    }
+}
+
+void MonitorLocal::getStats(MonitorLocalStats & stats) const
+{
+    stats.queueSize = queue->getSize();
+    stats.numberElements = queue->getNumberElements();
+    stats.maxQueueSize = queue->getCapacity();
+    stats.numberUsed = queue->getNumberUsed();
+    stats.numberCoalesced = epicsAtomicGetSizeT(&numberCoalesced);
+    stats.numberDropped = epicsAtomicGetSizeT(&numberDropped);
+    stats.numberBlocked = epicsAtomicGetSizeT(&numberBlocked);
+    stats.numberTimeouts = epicsAtomicGetSizeT(&numberTimeouts);
+    stats.numberEvents = epicsAtomicGetSizeT(&numberEvents);
+    stats.numberEventsSkipped = epicsAtomicGetSizeT(&numberEventsSkipped);
+    stats.credits = pipeline ? epicsAtomicGetIntT(&credits) : 0;
+    stats.numberDeferred = epicsAtomicGetSizeT(&numberDeferred);
+    stats.requesterName = requesterName;
+    stats.queueHighWater = epicsAtomicGetSizeT(&queueHighWater);
+    stats.numberOverrunElements = epicsAtomicGetSizeT(&numberOverrunElements);
+    stats.numberOverrunFields = epicsAtomicGetSizeT(&numberOverrunFields);
+    stats.numberPolled = epicsAtomicGetSizeT(&numberPolled);
+    stats.queueLatency.resize(MonitorLocalStats::numberLatencyBuckets);
+    stats.holdTime.resize(MonitorLocalStats::numberLatencyBuckets);
+    for(size_t i=0; i<MonitorLocalStats::numberLatencyBuckets; ++i) {
+        stats.queueLatency[i] = epicsAtomicGetSizeT(&queueLatency[i]);
+        stats.holdTime[i] = epicsAtomicGetSizeT(&holdTime[i]);
+    }
+}
+
+void MonitorLocalStats::add(MonitorLocalStats const & stats)
+{
+    queueSize += stats.queueSize;
+    numberElements += stats.numberElements;
+    maxQueueSize += stats.maxQueueSize;
+    numberUsed += stats.numberUsed;
+    numberCoalesced += stats.numberCoalesced;
+    numberDropped += stats.numberDropped;
+    numberBlocked += stats.numberBlocked;
+    numberTimeouts += stats.numberTimeouts;
+    numberEvents += stats.numberEvents;
+    numberEventsSkipped += stats.numberEventsSkipped;
+    credits += stats.credits;
+    numberDeferred += stats.numberDeferred;
+    if(stats.queueHighWater>queueHighWater) queueHighWater = stats.queueHighWater;
+    numberOverrunElements += stats.numberOverrunElements;
+    numberOverrunFields += stats.numberOverrunFields;
+    numberPolled += stats.numberPolled;
+    queueLatency.resize(numberLatencyBuckets);
+    holdTime.resize(numberLatencyBuckets);
+    for(size_t i=0; i<numberLatencyBuckets && i<stats.queueLatency.size(); ++i) {
+        queueLatency[i] += stats.queueLatency[i];
+    }
+    for(size_t i=0; i<numberLatencyBuckets && i<stats.holdTime.size(); ++i) {
+        holdTime[i] += stats.holdTime[i];
+    }
+}
+
+// all monitors created by createMonitorLocal, for getRecordMonitorStats
+static std::list<std::tr1::weak_ptr<MonitorLocal> > monitorLocalList;
+static Mutex monitorLocalListMutex;
+
+static void addMonitorLocal(MonitorLocalPtr const & monitor)
+{
+    Lock xx(monitorLocalListMutex);
+    std::list<std::tr1::weak_ptr<MonitorLocal> >::iterator iter = monitorLocalList.begin();
+    while(iter!=monitorLocalList.end()) {
+        if(iter->expired()) {
+            iter = monitorLocalList.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    monitorLocalList.push_back(monitor);
+}
+
+void getRecordMonitorStats(
+    PVRecordPtr const & pvRecord,
+    std::vector<MonitorLocalStats> & stats)
+{
+    stats.clear();
+    Lock xx(monitorLocalListMutex);
+    std::list<std::tr1::weak_ptr<MonitorLocal> >::iterator iter;
+    for(iter = monitorLocalList.begin(); iter!=monitorLocalList.end(); ++iter) {
+        MonitorLocalPtr monitor = iter->lock();
+        if(!monitor || monitor->getPVRecord()!=pvRecord) continue;
+        stats.push_back(MonitorLocalStats());
+        monitor->getStats(stats.back());
+    }
+}
+
+bool getMonitorLocalStats(
+    MonitorPtr const & monitor,
+    MonitorLocalStats & stats)
+{
+    MonitorLocalPtr monitorLocal = std::tr1::dynamic_pointer_cast<MonitorLocal>(monitor);
+    if(!monitorLocal) return false;
+    monitorLocal->getStats(stats);
+    return true;
+}
+
+bool getResumeRange(
+    PVRecordPtr const & pvRecord,
+    uint64 & first,
+    uint64 & last)
+{
+    ReplayRingPtr ring;
+    {
+        Lock xx(replayRingListMutex);
+        std::list<ReplayRingPtr>::iterator iter;
+        for(iter = replayRingList.begin(); iter!=replayRingList.end(); ++iter) {
+            if((*iter)->getPVRecord()==pvRecord) ring = *iter;
+        }
+    }
+    if(!ring) return false;
+    epicsGuard <PVRecord> guard(*pvRecord);
+    first = ring->getKeptAfter();
+    last = pvRecord->getSequenceNumber();
     return true;
 }
 
 MonitorPtr createMonitorLocal(
     PVRecordPtr const & pvRecord,
     MonitorRequester::shared_pointer const & monitorRequester,
-    PVStructurePtr const & pvRequest)
+    PVStructurePtr const & pvRequest,
+    short priority)
 {
     MonitorLocalPtr monitor(new MonitorLocal(
-        monitorRequester,pvRecord));
+        monitorRequester,pvRecord,priority));
     bool result = monitor->init(pvRequest);
     if(!result) {
         MonitorPtr monitor;
@@ -472,6 +2138,7 @@ MonitorPtr createMonitorLocal(
             failedToCreateMonitorStatus,monitor,structure);
         return nullMonitor;
     }
+    addMonitorLocal(monitor);
     if(pvRecord->getTraceLevel()>0)
     {
         cout << "MonitorFactory::createMonitor"
@@ -480,4 +2147,13 @@ MonitorPtr createMonitorLocal(
     return monitor;
 }
 
+MonitorPtr createMonitorLocal(
+    PVRecordPtr const & pvRecord,
+    MonitorRequester::shared_pointer const & monitorRequester,
+    PVStructurePtr const & pvRequest)
+{
+    return createMonitorLocal(pvRecord,monitorRequester,pvRequest,
+        ChannelProvider::PRIORITY_DEFAULT);
+}
+
 }}
@@ -43,12 +43,72 @@ extern "C" void pvdbl(const iocshArgBuf *args)
 }
 
 
+// upper bound in microseconds of the bucket that holds the given fraction of the counts
+static double latencyPercentile(std::vector<size_t> const & histogram,double fraction)
+{
+    size_t total = 0;
+    for(size_t i=0; i<histogram.size(); ++i) total += histogram[i];
+    if(total==0) return 0.0;
+    size_t sum = 0;
+    for(size_t i=0; i<histogram.size(); ++i) {
+        sum += histogram[i];
+        if(sum>=fraction*total) return double(size_t(2)<<i);
+    }
+    return double(size_t(2)<<(histogram.size() - 1));
+}
+
+static void showMonitorStats(std::string const & name,MonitorLocalStats const & stats)
+{
+    cout << name
+         << " queueSize " << stats.queueSize
+         << " elements " << stats.numberElements
+         << " highWater " << stats.queueHighWater
+         << " polled " << stats.numberPolled
+         << " coalesced " << stats.numberCoalesced
+         << " dropped " << stats.numberDropped
+         << " overrunElements " << stats.numberOverrunElements
+         << " overrunFields " << stats.numberOverrunFields
+         << " latency p50 < " << latencyPercentile(stats.queueLatency,.5) << "us"
+         << " p99 < " << latencyPercentile(stats.queueLatency,.99) << "us"
+         << " hold p99 < " << latencyPercentile(stats.holdTime,.99) << "us"
+         << endl;
+}
+
+static const iocshArg pvdbMonitorStatsArg0 = { "recordName", iocshArgString };
+static const iocshArg *pvdbMonitorStatsArgs[] = {&pvdbMonitorStatsArg0};
+static const iocshFuncDef pvdbMonitorStatsFuncDef = {
+    "pvdbMonitorStats", 1, pvdbMonitorStatsArgs
+};
+extern "C" void pvdbMonitorStats(const iocshArgBuf *args)
+{
+    char *sval = args[0].sval;
+    if(!sval) {
+        cout << "recordName not specified" << endl;
+        return;
+    }
+    PVRecordPtr pvRecord = PVDatabase::getMaster()->findRecord(sval);
+    if(!pvRecord) {
+        cout << sval << " not found" << endl;
+        return;
+    }
+    std::vector<MonitorLocalStats> stats;
+    getRecordMonitorStats(pvRecord,stats);
+    MonitorLocalStats total;
+    for(size_t i=0; i<stats.size(); ++i) {
+        showMonitorStats(stats[i].requesterName,stats[i]);
+        total.add(stats[i]);
+    }
+    cout << stats.size() << " monitors" << endl;
+    showMonitorStats("total",total);
+}
+
 static void registerChannelProviderLocal(void)
 {
     static int firstTime = 1;
     if (firstTime) {
         firstTime = 0;
         iocshRegister(&pvdblFuncDef, pvdbl);
+        iocshRegister(&pvdbMonitorStatsFuncDef, pvdbMonitorStats);
         getChannelProviderLocal();
     }
 }
@@ -14,12 +14,17 @@
 #include <string>
 #include <cstdio>
 #include <memory>
+#include <vector>
 #include <iostream>
+#include <sstream>
 
 #include <epicsStdio.h>
 #include <epicsMutex.h>
 #include <epicsEvent.h>
 #include <epicsThread.h>
+#include <epicsGuard.h>
+#include <epicsAtomic.h>
+#include <epicsTime.h>
 
 #include <pv/standardField.h>
 #include <pv/standardPVField.h>
@@ -182,6 +187,294 @@ public:
 };
 
 
+class LocalMonitorRequester;
+typedef std::tr1::shared_ptr<LocalMonitorRequester> LocalMonitorRequesterPtr;
+
+// Used with createMonitorLocal, i.e. without a pvAccess server.
+// The test itself calls poll and release.
+class LocalMonitorRequester : public MonitorRequester
+{
+public:
+    POINTER_DEFINITIONS(LocalMonitorRequester);
+    LocalMonitorRequester()
+    : numberEvents(0)
+    {
+    }
+
+    virtual string getRequesterName()
+    {
+        return "LocalMonitorRequester";
+    }
+
+    virtual void message(const std::string& message, MessageType messageType)
+    {
+        cout << "[" << getRequesterName() << "] message(" << message << ", " << getMessageTypeName(messageType) << ")" << endl;
+    }
+
+    virtual void monitorConnect(const epics::pvData::Status& status, const Monitor::shared_pointer& /*monitor*/, const Structure::const_shared_pointer& /*structure*/)
+    {
+        if (!status.isSuccess()) {
+            cout << "[" << getRequesterName() << "] failed to create monitor: " << status << endl;
+        }
+    }
+
+    virtual void monitorEvent(const Monitor::shared_pointer& /*monitor*/)
+    {
+        Lock xx(mutex);
+        ++numberEvents;
+    }
+
+    virtual void unlisten(const Monitor::shared_pointer& /*monitor*/)
+    {
+    }
+
+    size_t getNumberEvents()
+    {
+        Lock xx(mutex);
+        return numberEvents;
+    }
+
+private:
+    Mutex mutex;
+    size_t numberEvents;
+};
+
+static size_t drain(Monitor::shared_pointer const & monitor)
+{
+    size_t number = 0;
+    MonitorElementPtr element;
+    while ((element = monitor->poll())) {
+        ++number;
+        monitor->release(element);
+    }
+    return number;
+}
+
+static void putValue(PVRecordPtr const & pvRecord,PVIntPtr const & pvValue,int value)
+{
+    epicsGuard<PVRecord> guard(*pvRecord);
+    pvRecord->beginGroupPut();
+    pvValue->put(value);
+    pvRecord->endGroupPut();
+}
+
+// Polls and releases all queued elements, returns their values.
+static vector<int> pollValues(Monitor::shared_pointer const & monitor)
+{
+    vector<int> values;
+    MonitorElementPtr element;
+    while ((element = monitor->poll())) {
+        values.push_back(element->pvStructurePtr->getSubField<PVInt>("value")->get());
+        monitor->release(element);
+    }
+    return values;
+}
+
+static void arrayShareTest()
+{
+    if(debug) {cout << "****arrayShareTest****" << endl;}
+    PVDatabase::getMaster(); // registers the plugins
+    PVStructurePtr pvStructure = getStandardPVField()->scalarArray(pvDouble,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("doubleArrayShare",pvStructure);
+    PVDoubleArrayPtr pvValue = pvStructure->getSubField<PVDoubleArray>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest("value"));
+    LocalMonitorRequesterPtr filteredRequester(new LocalMonitorRequester());
+    Monitor::shared_pointer filtered = createMonitorLocal(
+        pvRecord,filteredRequester,CreateRequest::create()->createRequest("value[array=0:2:999]"));
+    testOk1(monitor->start().isOK() && filtered->start().isOK());
+    drain(monitor);
+    drain(filtered);
+
+    size_t n = 1000000;
+    shared_vector<double> values(n);
+    for(size_t i=0; i<n; ++i) values[i] = i;
+    shared_vector<const double> cvalues(freeze(values));
+    {
+        epicsGuard<PVRecord> guard(*pvRecord);
+        pvRecord->beginGroupPut();
+        pvValue->replace(cvalues);
+        pvRecord->endGroupPut();
+    }
+    // an unfiltered monitor shares the buffer, no element is copied
+    MonitorElementPtr element = monitor->poll();
+    testOk1(element
+        && element->pvStructurePtr->getSubField<PVDoubleArray>("value")->view().data()==cvalues.data());
+    if(element) monitor->release(element);
+    // a filter that modifies the array makes its own buffer
+    element = filtered->poll();
+    if(element) {
+        PVDoubleArray::const_svector view(
+            element->pvStructurePtr->getSubField<PVDoubleArray>("value")->view());
+        testOk1(view.size()==500 && view.data()!=cvalues.data() && view[1]==2.0);
+        filtered->release(element);
+    } else {
+        testFail("filtered monitor did not receive the array");
+    }
+    monitor->stop();
+    filtered->stop();
+}
+
+// Polls and releases monitor elements in its own thread, like the pvAccess sender.
+class MonitorConsumer : public epicsThreadRunable
+{
+public:
+    MonitorConsumer(Monitor::shared_pointer const & monitor)
+    : monitor(monitor),
+      thread(*this,"monitorConsumer",epicsThreadGetStackSize(epicsThreadStackSmall)),
+      done(0),
+      numberElements(0),
+      lastValue(-1)
+    {
+    }
+    void start() { thread.start(); }
+    void stop()
+    {
+        epicsAtomicSetIntT(&done,1);
+        thread.exitWait();
+    }
+    virtual void run()
+    {
+        while(!epicsAtomicGetIntT(&done)) {
+            MonitorElementPtr element = monitor->poll();
+            if(!element) {
+                epicsThreadSleep(0.0);
+                continue;
+            }
+            epicsAtomicSetIntT(&lastValue,
+                element->pvStructurePtr->getSubField<PVInt>("value")->get());
+            epicsAtomicIncrSizeT(&numberElements);
+            monitor->release(element);
+        }
+    }
+    size_t getNumberElements() { return epicsAtomicGetSizeT(&numberElements); }
+    int getLastValue() { return epicsAtomicGetIntT(&lastValue); }
+private:
+    Monitor::shared_pointer monitor;
+    epicsThread thread;
+    int done;
+    size_t numberElements;
+    int lastValue;
+};
+
+class WakeupRequester;
+typedef std::tr1::shared_ptr<WakeupRequester> WakeupRequesterPtr;
+
+// Signals a wakeup for each monitorEvent.
+class WakeupRequester : public LocalMonitorRequester
+{
+public:
+    POINTER_DEFINITIONS(WakeupRequester);
+    virtual void monitorEvent(const Monitor::shared_pointer& monitor)
+    {
+        LocalMonitorRequester::monitorEvent(monitor);
+        wakeup.signal();
+    }
+    void wait() { wakeup.wait(); }
+    void signal() { wakeup.signal(); }
+private:
+    Event wakeup;
+};
+
+// Polls until poll returns null after each wakeup, like the pvAccess sender,
+// so a lost wakeup leaves elements in the queue.
+class WakeupConsumer : public epicsThreadRunable
+{
+public:
+    WakeupConsumer(Monitor::shared_pointer const & monitor,WakeupRequesterPtr const & requester)
+    : monitor(monitor),
+      requester(requester),
+      thread(*this,"wakeupConsumer",epicsThreadGetStackSize(epicsThreadStackSmall)),
+      done(0),
+      lastValue(-1)
+    {
+    }
+    void start() { thread.start(); }
+    void stop()
+    {
+        epicsAtomicSetIntT(&done,1);
+        requester->signal();
+        thread.exitWait();
+    }
+    virtual void run()
+    {
+        while(true) {
+            requester->wait();
+            if(epicsAtomicGetIntT(&done)) return;
+            MonitorElementPtr element;
+            while((element = monitor->poll())) {
+                epicsAtomicSetIntT(&lastValue,
+                    element->pvStructurePtr->getSubField<PVInt>("value")->get());
+                monitor->release(element);
+            }
+        }
+    }
+    int getLastValue() { return epicsAtomicGetIntT(&lastValue); }
+private:
+    Monitor::shared_pointer monitor;
+    WakeupRequesterPtr requester;
+    epicsThread thread;
+    int done;
+    int lastValue;
+};
+
+class OrderRequester;
+typedef std::tr1::shared_ptr<OrderRequester> OrderRequesterPtr;
+
+// Records the monitors in the order of their monitorEvent calls.
+class OrderRequester : public LocalMonitorRequester
+{
+public:
+    POINTER_DEFINITIONS(OrderRequester);
+    virtual void monitorEvent(const Monitor::shared_pointer& monitor)
+    {
+        LocalMonitorRequester::monitorEvent(monitor);
+        Lock xx(orderMutex);
+        order.push_back(monitor.get());
+    }
+    vector<Monitor*> getOrder()
+    {
+        Lock xx(orderMutex);
+        return order;
+    }
+    void clear()
+    {
+        Lock xx(orderMutex);
+        order.clear();
+    }
+private:
+    Mutex orderMutex;
+    vector<Monitor*> order;
+};
+
+static void throughputTest()
+{
+    if(debug) {cout << "****throughputTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intThroughput",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest("record[queueSize=8]field(value)"));
+    monitor->start();
+    MonitorConsumer consumer(monitor);
+    consumer.start();
+    const int nupdates = 200000;
+    epicsTime start = epicsTime::getCurrent();
+    for(int i=1; i<=nupdates; ++i) putValue(pvRecord,pvValue,i);
+    double elapsed = epicsTime::getCurrent() - start;
+    // a final put flushes a change that was coalesced while the queue was full
+    epicsThreadSleep(.1);
+    putValue(pvRecord,pvValue,nupdates);
+    for(int i=0; i<100 && consumer.getLastValue()!=nupdates; ++i) epicsThreadSleep(.01);
+    testOk1(consumer.getLastValue()==nupdates);
+    consumer.stop();
+    monitor->stop();
+    testDiag("%d updates in %g seconds, %g updates/s, %lu elements delivered",
+        nupdates,elapsed,nupdates/elapsed,(unsigned long)consumer.getNumberElements());
+}
+
 static void test()
 {
     PVDatabasePtr master = PVDatabase::getMaster();
@@ -304,9 +597,857 @@ static void test()
 
 }
 
+// The client does not poll until all updates are done, i.e. the slowest consumer.
+static void overflowTest()
+{
+    if(debug) {cout << "****overflowTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intOverflow",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    const char *requests[] = {
+        "record[queueSize=3]field(value)",
+        "record[queueSize=3,overflow=dropOldest]field(value)",
+        "record[queueSize=3,overflow=block,blockTimeout=0.05]field(value)"
+    };
+    Monitor::shared_pointer monitors[3];
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    for(size_t i=0; i<3; ++i) {
+        monitors[i] = createMonitorLocal(
+            pvRecord,requester,CreateRequest::create()->createRequest(requests[i]));
+        monitors[i]->start();
+        drain(monitors[i]);
+    }
+    // two updates fill the queue, the remaining eight overflow
+    for(int i=1; i<=10; ++i) putValue(pvRecord,pvValue,i);
+    MonitorLocalStats stats[3];
+    vector<int> values[3];
+    for(size_t i=0; i<3; ++i) {
+        getMonitorLocalStats(monitors[i],stats[i]);
+        values[i] = pollValues(monitors[i]);
+        monitors[i]->stop();
+    }
+    testOk(stats[0].numberCoalesced==8 && stats[0].numberDropped==0
+        && values[0].size()==2 && values[0][0]==1 && values[0][1]==2,
+        "coalesce keeps the oldest updates");
+    testOk(stats[1].numberDropped==8 && stats[1].numberCoalesced==0
+        && values[1].size()==2 && values[1][0]==9 && values[1][1]==10,
+        "dropOldest keeps the newest updates");
+    testOk(stats[2].numberBlocked==8 && stats[2].numberTimeouts==8
+        && stats[2].numberCoalesced==8
+        && values[2].size()==2 && values[2][0]==1 && values[2][1]==2,
+        "block times out and then coalesces");
+
+    // with a consumer thread block delivers every update
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=2,overflow=block,blockTimeout=10]field(value)"));
+    monitor->start();
+    MonitorConsumer consumer(monitor);
+    consumer.start();
+    const int nupdates = 1000;
+    for(int i=1; i<=nupdates; ++i) putValue(pvRecord,pvValue,i);
+    for(int i=0; i<100 && consumer.getLastValue()!=nupdates; ++i) epicsThreadSleep(.01);
+    consumer.stop();
+    MonitorLocalStats blockStats;
+    getMonitorLocalStats(monitor,blockStats);
+    monitor->stop();
+    testOk(consumer.getNumberElements()==size_t(nupdates + 1)
+        && blockStats.numberTimeouts==0 && blockStats.numberCoalesced==0,
+        "block loses no update");
+
+    // with dispatch the dispatcher waits, not the writer
+    monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=2,dispatch=true,overflow=block,blockTimeout=0.5]field(value)"));
+    monitor->start();
+    for(int i=0; i<100 && drain(monitor)==0; ++i) epicsThreadSleep(.01);
+    // a put that waited for a free element would take blockTimeout
+    double maxPut = 0.0;
+    for(int i=1; i<=10; ++i) {
+        epicsTime start = epicsTime::getCurrent();
+        putValue(pvRecord,pvValue,i);
+        double elapsed = epicsTime::getCurrent() - start;
+        if(elapsed>maxPut) maxPut = elapsed;
+        epicsThreadSleep(.01);
+    }
+    MonitorLocalStats dispatchStats;
+    for(int i=0; i<100 && dispatchStats.numberTimeouts==0; ++i) {
+        epicsThreadSleep(.01);
+        getMonitorLocalStats(monitor,dispatchStats);
+    }
+    monitor->stop();
+    testDiag("longest put with dispatch %g seconds",maxPut);
+    testOk(maxPut<0.5 && dispatchStats.numberBlocked>0 && dispatchStats.numberTimeouts>0,
+        "block with dispatch does not block the writer");
+
+    Monitor::shared_pointer illegal = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[overflow=never]field(value)"));
+    testOk1(!illegal);
+}
+
+static void adaptiveQueueTest()
+{
+    if(debug) {cout << "****adaptiveQueueTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intAdaptive",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=2,maxQueueSize=16]field(value)"));
+    monitor->start();
+    drain(monitor);
+    // a client that does not poll makes the queue grow to its cap
+    for(int i=1; i<=20; ++i) putValue(pvRecord,pvValue,i);
+    MonitorLocalStats stats;
+    getMonitorLocalStats(monitor,stats);
+    vector<int> values = pollValues(monitor);
+    testOk(stats.queueSize==16 && stats.maxQueueSize==16
+        && stats.numberCoalesced==5 && values.size()==15 && values[14]==15,
+        "queue grows to maxQueueSize");
+    // a client that keeps up makes it shrink again
+    for(int i=1; i<=2000; ++i) {
+        putValue(pvRecord,pvValue,i);
+        drain(monitor);
+    }
+    getMonitorLocalStats(monitor,stats);
+    testDiag("queueSize after 2000 polled updates %lu",(unsigned long)stats.queueSize);
+    testOk(stats.queueSize==4,"queue shrinks when underused");
+    monitor->stop();
+}
+
+// Measures the put latency with a number of monitors that do the copy
+// on the put thread or in the dispatcher threads.
+static void dispatchTest()
+{
+    if(debug) {cout << "****dispatchTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intDispatch",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    const size_t numberSubscribers[] = {0,10,100};
+    const int nupdates = 2000;
+    for(size_t dispatch=0; dispatch<2; ++dispatch) {
+        for(size_t n=0; n<3; ++n) {
+            LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+            string request(dispatch ? "record[dispatch=true]field(value)" : "field(value)");
+            vector<Monitor::shared_pointer> monitors;
+            for(size_t i=0; i<numberSubscribers[n]; ++i) {
+                monitors.push_back(createMonitorLocal(
+                    pvRecord,requester,CreateRequest::create()->createRequest(request)));
+                monitors.back()->start();
+                drain(monitors.back());
+            }
+            epicsTime start = epicsTime::getCurrent();
+            for(int i=1; i<=nupdates; ++i) putValue(pvRecord,pvValue,i);
+            double elapsed = epicsTime::getCurrent() - start;
+            testDiag("%s %lu subscribers: put latency %g microseconds",
+                (dispatch ? "dispatch" : "direct"),(unsigned long)numberSubscribers[n],
+                elapsed/nupdates*1e6);
+            if(dispatch && numberSubscribers[n]>0) {
+                // every subscriber sees the final value
+                epicsThreadSleep(.1);
+                for(size_t i=0; i<monitors.size(); ++i) drain(monitors[i]);
+                putValue(pvRecord,pvValue,nupdates + 1);
+                size_t numberFinal = 0;
+                for(size_t i=0; i<monitors.size(); ++i) {
+                    vector<int> values;
+                    for(int wait=0; wait<100 && values.empty(); ++wait) {
+                        values = pollValues(monitors[i]);
+                        if(values.empty()) epicsThreadSleep(.01);
+                    }
+                    if(!values.empty() && values.back()==nupdates + 1) ++numberFinal;
+                }
+                testOk(numberFinal==monitors.size(),
+                    "dispatch delivers to %lu subscribers",(unsigned long)monitors.size());
+            }
+            for(size_t i=0; i<monitors.size(); ++i) monitors[i]->stop();
+        }
+    }
+}
+
+// Each monitor copies half of a large array in endGroupPut,
+// PVRecord::setListenerThreads spreads the monitors over threads.
+// A listener that is not parallel safe, it remembers the thread that called endGroupPut.
+class ThreadListener :
+    public PVListener
+{
+public:
+    POINTER_DEFINITIONS(ThreadListener);
+    ThreadListener() : threadId(0) {}
+    virtual ~ThreadListener() {}
+    virtual void detach(PVRecordPtr const & pvRecord) {}
+    virtual void dataPut(PVRecordFieldPtr const & pvRecordField) {}
+    virtual void dataPut(
+        PVRecordStructurePtr const & requested,
+        PVRecordFieldPtr const & pvRecordField) {}
+    virtual void beginGroupPut(PVRecordPtr const & pvRecord) {}
+    virtual void endGroupPut(PVRecordPtr const & pvRecord) {threadId = epicsThreadGetIdSelf();}
+    virtual void unlisten(PVRecordPtr const & pvRecord) {}
+    epicsThreadId threadId;
+};
+
+// A parallel safe listener that throws in endGroupPut.
+class ThrowListener :
+    public ThreadListener
+{
+public:
+    POINTER_DEFINITIONS(ThrowListener);
+    virtual void endGroupPut(PVRecordPtr const & pvRecord) {throw 1;}
+    virtual bool isParallelSafe() const {return true;}
+};
+
+static void parallelEndGroupPutTest()
+{
+    if(debug) {cout << "****parallelEndGroupPutTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalarArray(pvDouble,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("doubleParallel",pvStructure);
+    PVDoubleArrayPtr pvValue = pvStructure->getSubField<PVDoubleArray>("value");
+    const size_t numberSubscribers = 64;
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    vector<Monitor::shared_pointer> monitors;
+    for(size_t i=0; i<numberSubscribers; ++i) {
+        monitors.push_back(createMonitorLocal(
+            pvRecord,requester,CreateRequest::create()->createRequest(
+                "record[queueSize=3]field(value[array=0:2:9999])")));
+        monitors.back()->start();
+        drain(monitors.back());
+    }
+    shared_vector<double> values(10000);
+    for(size_t i=0; i<values.size(); ++i) values[i] = i;
+    shared_vector<const double> cvalues(freeze(values));
+    size_t numberCPUs = epicsThreadGetCPUs();
+    const int nupdates = 200;
+    for(size_t numberThreads=1; numberThreads<=numberCPUs; numberThreads*=2) {
+        pvRecord->setListenerThreads(numberThreads);
+        epicsTime start = epicsTime::getCurrent();
+        for(int i=0; i<nupdates; ++i) {
+            epicsGuard<PVRecord> guard(*pvRecord);
+            pvRecord->beginGroupPut();
+            pvValue->replace(cvalues);
+            pvRecord->endGroupPut();
+        }
+        double elapsed = epicsTime::getCurrent() - start;
+        testDiag("%lu subscribers %lu threads: put latency %g microseconds",
+            (unsigned long)numberSubscribers,(unsigned long)numberThreads,
+            elapsed/nupdates*1e6);
+    }
+    // every subscriber gets both updates in order
+    pvRecord->setListenerThreads(4);
+    for(size_t i=0; i<monitors.size(); ++i) drain(monitors[i]);
+    for(int marker=1; marker<=2; ++marker) {
+        shared_vector<double> update(10000,-marker);
+        epicsGuard<PVRecord> guard(*pvRecord);
+        pvRecord->beginGroupPut();
+        pvValue->replace(freeze(update));
+        pvRecord->endGroupPut();
+    }
+    size_t numberInOrder = 0;
+    for(size_t i=0; i<monitors.size(); ++i) {
+        vector<double> first;
+        MonitorElementPtr element;
+        while ((element = monitors[i]->poll())) {
+            first.push_back(element->pvStructurePtr->getSubField<PVDoubleArray>("value")->view()[0]);
+            monitors[i]->release(element);
+        }
+        if(first.size()==2 && first[0]==-1.0 && first[1]==-2.0) ++numberInOrder;
+    }
+    testOk(numberInOrder==numberSubscribers,"parallel endGroupPut keeps the order per subscriber");
+    // a listener that is not parallel safe is called by the thread that puts
+    ThreadListener::shared_pointer listener(new ThreadListener());
+    epics::pvCopy::PVCopyPtr pvCopy(epics::pvCopy::PVCopy::create(
+        pvStructure,CreateRequest::create()->createRequest("field(value)"),""));
+    pvRecord->addListener(listener,pvCopy);
+    for(size_t i=0; i<10; ++i) {
+        epicsGuard<PVRecord> guard(*pvRecord);
+        pvRecord->beginGroupPut();
+        pvValue->replace(cvalues);
+        pvRecord->endGroupPut();
+        if(listener->threadId!=epicsThreadGetIdSelf()) break;
+    }
+    testOk(listener->threadId==epicsThreadGetIdSelf(),
+        "a listener that is not parallel safe is called by the caller");
+    pvRecord->removeListener(listener,pvCopy);
+    // added last, the listener is in the part of a listener thread
+    ThrowListener::shared_pointer throwListener(new ThrowListener());
+    pvRecord->addListener(throwListener,pvCopy);
+    bool thrown = false;
+    try {
+        epicsGuard<PVRecord> guard(*pvRecord);
+        pvRecord->beginGroupPut();
+        pvValue->replace(cvalues);
+        pvRecord->endGroupPut();
+    } catch(...) {
+        thrown = true;
+    }
+    pvRecord->removeListener(throwListener,pvCopy);
+    testOk(thrown,"endGroupPut throws the exception of a listener in another thread");
+    for(size_t i=0; i<monitors.size(); ++i) monitors[i]->stop();
+}
+
+static void edgeNotifyTest()
+{
+    if(debug) {cout << "****edgeNotifyTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intEdgeNotify",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=20,notify=edge]field(value)"));
+    monitor->start();
+    drain(monitor);
+    // only the first of ten queued elements is signaled
+    for(int i=1; i<=10; ++i) putValue(pvRecord,pvValue,i);
+    size_t numberEvents = requester->getNumberEvents();
+    drain(monitor);
+    // poll returned null, so the next element is signaled again
+    putValue(pvRecord,pvValue,11);
+    MonitorLocalStats stats;
+    getMonitorLocalStats(monitor,stats);
+    testOk(numberEvents==2 && requester->getNumberEvents()==3
+        && stats.numberEvents==3 && stats.numberEventsSkipped==9,
+        "notify=edge signals the empty to non empty transition");
+    monitor->stop();
+
+    const char *requests[] = {
+        "record[queueSize=8]field(value)",
+        "record[queueSize=8,notify=edge]field(value)"
+    };
+    const int nupdates = 100000;
+    for(size_t i=0; i<2; ++i) {
+        WakeupRequesterPtr wakeupRequester(new WakeupRequester());
+        monitor = createMonitorLocal(
+            pvRecord,wakeupRequester,CreateRequest::create()->createRequest(requests[i]));
+        monitor->start();
+        WakeupConsumer consumer(monitor,wakeupRequester);
+        consumer.start();
+        for(int value=1; value<=nupdates; ++value) putValue(pvRecord,pvValue,value);
+        // a final put flushes a change that was coalesced while the queue was full
+        epicsThreadSleep(.1);
+        putValue(pvRecord,pvValue,nupdates);
+        for(int wait=0; wait<500 && consumer.getLastValue()!=nupdates; ++wait) epicsThreadSleep(.01);
+        int lastValue = consumer.getLastValue();
+        consumer.stop();
+        getMonitorLocalStats(monitor,stats);
+        monitor->stop();
+        testDiag("%s: %lu monitorEvent calls, %lu skipped",requests[i],
+            (unsigned long)stats.numberEvents,(unsigned long)stats.numberEventsSkipped);
+        if(i==1) testOk(lastValue==nupdates,"notify=edge loses no wakeup");
+    }
+}
+
+// A slow pipeline client: it polls but reports free elements only later.
+static void pipelineTest()
+{
+    if(debug) {cout << "****pipelineTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intPipeline",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=4,pipeline=true]field(value)"));
+    monitor->start();
+    // the initial element uses the first credit
+    drain(monitor);
+    for(int i=1; i<=10; ++i) putValue(pvRecord,pvValue,i);
+    MonitorLocalStats stats;
+    getMonitorLocalStats(monitor,stats);
+    vector<int> values = pollValues(monitor);
+    testOk(stats.credits==0 && stats.numberDeferred==7 && stats.numberCoalesced==0
+        && values.size()==3 && values[2]==3,
+        "no copy once the credits are used");
+    monitor->reportRemoteQueueStatus(2);
+    MonitorElementPtr element = monitor->poll();
+    bool latest = element
+        && element->pvStructurePtr->getSubField<PVInt>("value")->get()==10
+        && element->overrunBitSet->nextSetBit(0)>=0;
+    if(element) monitor->release(element);
+    getMonitorLocalStats(monitor,stats);
+    testOk(latest && stats.credits==1,
+        "free elements send the accumulated changes");
+    monitor->stop();
+}
+
+static void instrumentationTest()
+{
+    if(debug) {cout << "****instrumentationTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intInstrumentation",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitors[2];
+    for(size_t i=0; i<2; ++i) {
+        monitors[i] = createMonitorLocal(
+            pvRecord,requester,CreateRequest::create()->createRequest(
+                "record[queueSize=4]field(value)"));
+        monitors[i]->start();
+        drain(monitors[i]);
+    }
+    // each group put changes value twice, i.e. overruns it
+    for(int i=1; i<=3; ++i) {
+        epicsGuard<PVRecord> guard(*pvRecord);
+        pvRecord->beginGroupPut();
+        pvValue->put(10*i);
+        pvValue->put(10*i + 1);
+        pvRecord->endGroupPut();
+    }
+    epicsThreadSleep(.02);
+    drain(monitors[0]);
+    MonitorLocalStats stats;
+    getMonitorLocalStats(monitors[0],stats);
+    // the initial element was polled at once, the other three after at least 16 ms
+    size_t numberLate = 0;
+    for(size_t i=14; i<stats.queueLatency.size(); ++i) numberLate += stats.queueLatency[i];
+    testOk(stats.numberPolled==4 && numberLate==3 && stats.queueHighWater==3
+        && stats.numberOverrunElements==3 && stats.numberOverrunFields==3,
+        "latency, high water and overrun counts");
+    vector<MonitorLocalStats> recordStats;
+    getRecordMonitorStats(pvRecord,recordStats);
+    MonitorLocalStats total;
+    for(size_t i=0; i<recordStats.size(); ++i) total.add(recordStats[i]);
+    testOk(recordStats.size()==2 && total.numberPolled==5 && total.queueHighWater==3
+        && total.numberOverrunElements==6 && total.queueSize==8,
+        "statistics aggregated per record");
+    for(size_t i=0; i<2; ++i) monitors[i]->stop();
+}
+
+// Polls and releases all queued elements of a batch monitor, returns their value arrays.
+static vector<vector<int> > pollBatches(Monitor::shared_pointer const & monitor)
+{
+    vector<vector<int> > batches;
+    MonitorElementPtr element;
+    while ((element = monitor->poll())) {
+        PVIntArray::const_svector values =
+            element->pvStructurePtr->getSubField<PVIntArray>("value")->view();
+        batches.push_back(vector<int>(values.begin(),values.end()));
+        monitor->release(element);
+    }
+    return batches;
+}
+
+static void batchTest()
+{
+    if(debug) {cout << "****batchTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intBatch",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=4,batch=5]field(value,timeStamp)"));
+    monitor->start();
+    vector<vector<int> > batches = pollBatches(monitor);
+    testOk(batches.size()==1 && batches[0].size()==1,"initial element holds one sample");
+    for(int i=1; i<=12; ++i) putValue(pvRecord,pvValue,i);
+    MonitorElementPtr element = monitor->poll();
+    bool timeStamps = element && element->pvStructurePtr->getSubField<PVLongArray>(
+        "timeStamp.secondsPastEpoch")->getLength()==5;
+    if(element) monitor->release(element);
+    batches = pollBatches(monitor);
+    testOk(timeStamps && batches.size()==1 && batches[0].size()==5
+        && batches[0][0]==6 && batches[0][4]==10,
+        "one element per 5 samples");
+    monitor->stop();
+
+    // while the queue is full all samples are kept
+    monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=2,batch=3]field(value)"));
+    monitor->start();
+    for(int i=1; i<=6; ++i) putValue(pvRecord,pvValue,i);
+    drain(monitor);
+    putValue(pvRecord,pvValue,7);
+    batches = pollBatches(monitor);
+    testOk(batches.size()==1 && batches[0].size()==7
+        && batches[0][0]==1 && batches[0][6]==7,
+        "no sample lost while the queue is full");
+    monitor->stop();
+
+    monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[batchPeriod=0.05]field(value)"));
+    monitor->start();
+    drain(monitor);
+    for(int i=1; i<=3; ++i) putValue(pvRecord,pvValue,i);
+    size_t early = drain(monitor);
+    // the timer sends the batch, no further update is needed
+    batches.clear();
+    for(int i=0; i<100 && batches.empty(); ++i) {
+        epicsThreadSleep(.01);
+        batches = pollBatches(monitor);
+    }
+    testOk(early==0 && batches.size()==1 && batches[0].size()==3,
+        "one element per period");
+    monitor->stop();
+
+    PVRecordPtr pvArrayRecord = PVRecord::create("doubleArrayBatch",
+        getStandardPVField()->scalarArray(pvDouble,"timeStamp"));
+    monitor = createMonitorLocal(
+        pvArrayRecord,requester,CreateRequest::create()->createRequest(
+            "record[batch=5]field(value)"));
+    testOk(!monitor,"batch of an array field is refused");
+}
+
+// Elements held by many idle monitors, each with its own or with a shared pool.
+static void sharedPoolTest()
+{
+    if(debug) {cout << "****sharedPoolTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"alarm,timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intSharedPool",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(
+        pvRecord,requester,CreateRequest::create()->createRequest(
+            "record[queueSize=3,sharedPool=true]field()"));
+    monitor->start();
+    drain(monitor);
+    for(int i=1; i<=3; ++i) putValue(pvRecord,pvValue,i);
+    MonitorLocalStats stats;
+    getMonitorLocalStats(monitor,stats);
+    size_t inUse = stats.numberElements;
+    vector<int> values = pollValues(monitor);
+    getMonitorLocalStats(monitor,stats);
+    testOk(inUse==3 && stats.numberElements==1
+        && values.size()==2 && values[0]==1 && values[1]==2,
+        "elements are borrowed while in use");
+    monitor->stop();
+    monitor.reset();
+
+    const size_t nmonitors = 10000;
+    const char *requests[2] = {
+        "record[queueSize=4]field()",
+        "record[queueSize=4,sharedPool=true]field()"};
+    size_t numberElements[2];
+    for(size_t i=0; i<2; ++i) {
+        vector<Monitor::shared_pointer> monitors(nmonitors);
+        PVStructurePtr pvRequest = CreateRequest::create()->createRequest(requests[i]);
+        epicsTime start = epicsTime::getCurrent();
+        for(size_t j=0; j<nmonitors; ++j) {
+            monitors[j] = createMonitorLocal(pvRecord,requester,pvRequest);
+            monitors[j]->start();
+            drain(monitors[j]);
+        }
+        double elapsed = epicsTime::getCurrent() - start;
+        // one update that every client handles at once
+        putValue(pvRecord,pvValue,10);
+        for(size_t j=0; j<nmonitors; ++j) drain(monitors[j]);
+        MonitorLocalStats total;
+        for(size_t j=0; j<nmonitors; ++j) {
+            getMonitorLocalStats(monitors[j],stats);
+            total.add(stats);
+        }
+        numberElements[i] = total.numberElements;
+        testDiag("%s: %lu idle monitors hold %lu elements, created in %g seconds",
+            requests[i],(unsigned long)nmonitors,(unsigned long)total.numberElements,elapsed);
+        for(size_t j=0; j<nmonitors; ++j) monitors[j]->stop();
+    }
+    testOk(numberElements[0]==4*nmonitors && numberElements[1]==nmonitors,
+        "idle monitors with a shared pool only hold their active element");
+}
+
+static void replayTest()
+{
+    if(debug) {cout << "****replayTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intReplay",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    PVStructurePtr pvRequest = CreateRequest::create()->createRequest(
+        "record[replay=3]field(value,timeStamp)");
+    Monitor::shared_pointer first = createMonitorLocal(pvRecord,requester,pvRequest);
+    first->start();
+    drain(first);
+    for(int i=1; i<=5; ++i) putValue(pvRecord,pvValue,i);
+    drain(first);
+    Monitor::shared_pointer late = createMonitorLocal(pvRecord,requester,pvRequest);
+    late->start();
+    vector<int> values;
+    vector<bool> complete;
+    MonitorElementPtr element;
+    while ((element = late->poll())) {
+        values.push_back(element->pvStructurePtr->getSubField<PVInt>("value")->get());
+        complete.push_back(element->changedBitSet->get(0));
+        late->release(element);
+    }
+    testOk(values.size()==4 && values[0]==3 && values[1]==4 && values[2]==5 && values[3]==5
+        && complete[0] && !complete[1] && complete[3],
+        "a late monitor gets the last updates before the initial element");
+    late->stop();
+    // the ring only kept 3 updates
+    late = createMonitorLocal(pvRecord,requester,CreateRequest::create()->createRequest(
+        "record[replay=10]field(value)"));
+    late->start();
+    values = pollValues(late);
+    testOk(values.size()==4 && values[0]==3,"replay is limited to the updates kept");
+    late->stop();
+    first->stop();
+}
+
+// Polls and releases all queued elements, returns the sequence numbers in timeStamp.userTag.
+static vector<int> pollSequenceNumbers(Monitor::shared_pointer const & monitor,size_t & numberComplete)
+{
+    vector<int> sequenceNumbers;
+    numberComplete = 0;
+    MonitorElementPtr element;
+    while ((element = monitor->poll())) {
+        sequenceNumbers.push_back(element->pvStructurePtr->getSubField<PVInt>("timeStamp.userTag")->get());
+        if(element->changedBitSet->get(0)) ++numberComplete;
+        monitor->release(element);
+    }
+    return sequenceNumbers;
+}
+
+static void resumeTest()
+{
+    if(debug) {cout << "****resumeTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intResume",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer first = createMonitorLocal(pvRecord,requester,
+        CreateRequest::create()->createRequest(
+            "record[replay=4]field(value,timeStamp.userTag[sequence=true])"));
+    first->start();
+    drain(first);
+    for(int i=1; i<=3; ++i) putValue(pvRecord,pvValue,i);
+    size_t numberComplete = 0;
+    vector<int> sequenceNumbers = pollSequenceNumbers(first,numberComplete);
+    uint64 current = 0;
+    {
+        epicsGuard<PVRecord> guard(*pvRecord);
+        current = pvRecord->getSequenceNumber();
+    }
+    testOk(sequenceNumbers.size()==3 && sequenceNumbers[2]==int(current)
+        && sequenceNumbers[1]==sequenceNumbers[0] + 1 && sequenceNumbers[2]==sequenceNumbers[1] + 1,
+        "each update carries the record sequence number");
+    // a client that saw the first of the three updates reconnects
+    std::stringstream request;
+    request << "record[replay=4,resume=" << sequenceNumbers[0]
+            << "]field(value,timeStamp.userTag[sequence=true])";
+    Monitor::shared_pointer resumed = createMonitorLocal(pvRecord,requester,
+        CreateRequest::create()->createRequest(request.str()));
+    resumed->start();
+    vector<int> resumedNumbers = pollSequenceNumbers(resumed,numberComplete);
+    testOk(resumedNumbers.size()==2 && resumedNumbers[0]==sequenceNumbers[1]
+        && resumedNumbers[1]==sequenceNumbers[2] && numberComplete==0,
+        "a resumed monitor only gets the updates it missed");
+    resumed->stop();
+    // the ring only keeps the last 4 updates
+    for(int i=4; i<=10; ++i) putValue(pvRecord,pvValue,i);
+    drain(first);
+    uint64 firstResume = 0;
+    uint64 lastResume = 0;
+    bool result = getResumeRange(pvRecord,firstResume,lastResume);
+    resumed = createMonitorLocal(pvRecord,requester,
+        CreateRequest::create()->createRequest(request.str()));
+    resumed->start();
+    vector<int> values = pollValues(resumed);
+    testOk(result && firstResume>uint64(sequenceNumbers[0]) && lastResume==current + 7
+        && values.size()==1 && values[0]==10,
+        "a client too far behind gets a complete element");
+    resumed->stop();
+    first->stop();
+    resumed.reset();
+    first.reset();
+    testOk(!getResumeRange(pvRecord,firstResume,lastResume),
+        "the ring is removed with the last replay monitor");
+}
+
+// Returns the indexes of the monitors that wait for a free element.
+static vector<size_t> getBlocked(vector<Monitor::shared_pointer> const & monitors)
+{
+    vector<size_t> blocked;
+    for(size_t i=0; i<monitors.size(); ++i) {
+        MonitorLocalStats stats;
+        getMonitorLocalStats(monitors[i],stats);
+        if(stats.numberBlocked>0) blocked.push_back(i);
+    }
+    return blocked;
+}
+
+// Releases one queued element of monitor.
+static void releaseOne(Monitor::shared_pointer const & monitor)
+{
+    MonitorElementPtr element = monitor->poll();
+    if(element) monitor->release(element);
+}
+
+static void priorityTest()
+{
+    if(debug) {cout << "****priorityTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intPriority",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    OrderRequesterPtr requester(new OrderRequester());
+    PVStructurePtr pvRequest = CreateRequest::create()->createRequest("field(value)");
+    Monitor::shared_pointer low = createMonitorLocal(
+        pvRecord,requester,pvRequest,ChannelProvider::PRIORITY_MIN);
+    Monitor::shared_pointer high = createMonitorLocal(
+        pvRecord,requester,pvRequest,ChannelProvider::PRIORITY_MAX);
+    low->start();
+    high->start();
+    drain(low);
+    drain(high);
+    requester->clear();
+    putValue(pvRecord,pvValue,1);
+    vector<Monitor*> order = requester->getOrder();
+    testOk(order.size()==2 && order[0]==high.get() && order[1]==low.get(),
+        "the higher priority monitor is notified first");
+    low->stop();
+    high->stop();
+
+    // Every dispatcher thread is held by a monitor of another record that waits
+    // for a free element. The low priority monitors are then queued before the
+    // high priority one and a single thread is let go, which must take the
+    // high priority monitor first.
+    const size_t nlow = 20;
+    PVStructurePtr pvLowStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvLowRecord = PVRecord::create("intPriorityLow",pvLowStructure);
+    PVIntPtr pvLowValue = pvLowStructure->getSubField<PVInt>("value");
+    pvRequest = CreateRequest::create()->createRequest("record[dispatch=true]field(value)");
+    vector<Monitor::shared_pointer> lows;
+    for(size_t i=0; i<nlow; ++i) {
+        lows.push_back(createMonitorLocal(
+            pvLowRecord,requester,pvRequest,ChannelProvider::PRIORITY_MIN));
+        lows.back()->start();
+        drain(lows.back());
+    }
+    high = createMonitorLocal(pvRecord,requester,pvRequest,ChannelProvider::PRIORITY_MAX);
+    high->start();
+    drain(high);
+    PVStructurePtr pvBlockStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvBlockRecord = PVRecord::create("intPriorityBlock",pvBlockStructure);
+    PVIntPtr pvBlockValue = pvBlockStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr blockRequester(new LocalMonitorRequester());
+    pvRequest = CreateRequest::create()->createRequest(
+        "record[queueSize=2,dispatch=true,overflow=block,blockTimeout=10]field(value)");
+    // there are at most 4 dispatcher threads
+    vector<Monitor::shared_pointer> blockers;
+    for(size_t i=0; i<4; ++i) {
+        blockers.push_back(createMonitorLocal(
+            pvBlockRecord,blockRequester,pvRequest,ChannelProvider::PRIORITY_MIN));
+        blockers.back()->start();
+    }
+    vector<size_t> blocked;
+    for(int i=1; i<=100 && blocked.empty(); ++i) {
+        putValue(pvBlockRecord,pvBlockValue,i);
+        epicsThreadSleep(.01);
+        blocked = getBlocked(blockers);
+    }
+    // let the other threads reach their monitor
+    epicsThreadSleep(.2);
+    blocked = getBlocked(blockers);
+    requester->clear();
+    putValue(pvLowRecord,pvLowValue,1);
+    putValue(pvRecord,pvValue,2);
+    if(!blocked.empty()) releaseOne(blockers[blocked[0]]);
+    for(int i=0; i<100 && requester->getOrder().empty(); ++i) epicsThreadSleep(.01);
+    order = requester->getOrder();
+    bool highFirst = !order.empty() && order[0]==high.get();
+    // let every thread go
+    for(size_t i=0; i<blockers.size(); ++i) releaseOne(blockers[i]);
+    for(int i=0; i<500 && requester->getOrder().size()<nlow + 1; ++i) epicsThreadSleep(.01);
+    order = requester->getOrder();
+    testDiag("%lu dispatcher threads held, %lu monitors dispatched",
+        (unsigned long)blocked.size(),(unsigned long)order.size());
+    testOk(!blocked.empty() && highFirst && order.size()==nlow + 1,
+        "the dispatcher takes the higher priority monitor first");
+    for(size_t i=0; i<blockers.size(); ++i) blockers[i]->stop();
+    for(size_t i=0; i<nlow; ++i) lows[i]->stop();
+    high->stop();
+}
+
+static void rateTest()
+{
+    if(debug) {cout << "****rateTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intRate",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(pvRecord,requester,
+        CreateRequest::create()->createRequest("field(value[rate=10])"));
+    monitor->start();
+    drain(monitor);
+    for(int i=1; i<=5; ++i) putValue(pvRecord,pvValue,i);
+    vector<int> values = pollValues(monitor);
+    testOk(values.empty(),"changes within the interval are held back");
+    // the record stays idle, the timer sends the last value
+    epicsThreadSleep(.3);
+    values = pollValues(monitor);
+    testOk(values.size()==1 && values[0]==5,"the latest value is sent after the interval");
+    monitor->stop();
+}
+
+static void decimateTest()
+{
+    if(debug) {cout << "****decimateTest****" << endl;}
+    PVStructurePtr pvStructure = getStandardPVField()->scalar(pvInt,"timeStamp");
+    PVRecordPtr pvRecord = PVRecord::create("intDecimate",pvStructure);
+    PVIntPtr pvValue = pvStructure->getSubField<PVInt>("value");
+    LocalMonitorRequesterPtr requester(new LocalMonitorRequester());
+    Monitor::shared_pointer monitor = createMonitorLocal(pvRecord,requester,
+        CreateRequest::create()->createRequest("record[queueSize=10]field(value[decimate=3])"));
+    monitor->start();
+    // the initial update is the first of three
+    drain(monitor);
+    for(int i=1; i<=9; ++i) putValue(pvRecord,pvValue,i);
+    vector<int> values = pollValues(monitor);
+    if(debug) {
+        for(size_t i=0; i<values.size(); ++i) cout << values[i] << " ";
+        cout << endl;
+    }
+    testOk(values.size()==3 && values[0]==3 && values[1]==6 && values[2]==9,
+        "decimate=3 sends every third change");
+    monitor->stop();
+
+    // the other fields of a suppressed update are not sent either
+    monitor = createMonitorLocal(pvRecord,requester,
+        CreateRequest::create()->createRequest("record[queueSize=10]field(value[decimate=3],timeStamp)"));
+    monitor->start();
+    drain(monitor);
+    PVIntPtr pvUserTag = pvStructure->getSubField<PVInt>("timeStamp.userTag");
+    for(int i=1; i<=9; ++i) {
+        epicsGuard<PVRecord> guard(*pvRecord);
+        pvRecord->beginGroupPut();
+        pvValue->put(i);
+        pvUserTag->put(i);
+        pvRecord->endGroupPut();
+    }
+    size_t numberElements = 0;
+    bool ok = true;
+    MonitorElementPtr element;
+    while((element = monitor->poll())) {
+        ++numberElements;
+        int value = element->pvStructurePtr->getSubField<PVInt>("value")->get();
+        int userTag = element->pvStructurePtr->getSubField<PVInt>("timeStamp.userTag")->get();
+        if(value!=3*int(numberElements) || userTag!=value) ok = false;
+        monitor->release(element);
+    }
+    testOk(ok && numberElements==3,"decimate=3 with timeStamp sends every third update");
+    monitor->stop();
+}
+
 MAIN(testChannelMonitor)
 {
-    testPlan(16);
+    testPlan(58);
     test();
+    arrayShareTest();
+    throughputTest();
+    overflowTest();
+    adaptiveQueueTest();
+    dispatchTest();
+    parallelEndGroupPutTest();
+    edgeNotifyTest();
+    pipelineTest();
+    instrumentationTest();
+    batchTest();
+    sharedPoolTest();
+    replayTest();
+    priorityTest();
+    resumeTest();
+    rateTest();
+    decimateTest();
     return 0;
 }
@@ -16,6 +16,7 @@
 #include <cstdlib>
 #include <cstddef>
 #include <string>
+#include <sstream>
 #include <cstdio>
 #include <memory>
 #include <iostream>
@@ -24,6 +25,7 @@
 #include <epicsMutex.h>
 #include <epicsEvent.h>
 #include <epicsThread.h>
+#include <epicsTime.h>
 
 #include <pv/standardField.h>
 #include <pv/standardPVField.h>
@@ -421,6 +423,119 @@ static void powerSupplyTest()
     testPVScalar(valueNameRecord,valueNameCopy,pvRecord,pvCopy);
 }
 
+static string leafValue(ScalarType scalarType,int value)
+{
+    if(scalarType==pvBoolean) return (value%2) ? "true" : "false";
+    std::stringstream ss;
+    ss << value;
+    return ss.str();
+}
+
+static void leafKernelTest()
+{
+    if(debug) {cout << endl << endl << "****leafKernelTest****" << endl;}
+    CreateRequest::shared_pointer createRequest = CreateRequest::create();
+    PVStructurePtr pvRequest = createRequest->createRequest("value");
+    const int nloop = 10000;
+    const size_t nelements = 10000;
+    for(int ind=pvBoolean; ind<=pvString; ++ind) {
+        ScalarType scalarType = static_cast<ScalarType>(ind);
+        string typeName(ScalarTypeFunc::name(scalarType));
+
+        PVRecordPtr pvRecord = createScalar(typeName + "Record",scalarType,"");
+        PVStructurePtr pvStructureRecord = pvRecord->getPVRecordStructure()->getPVStructure();
+        PVCopyPtr pvCopy = PVCopy::create(pvStructureRecord,pvRequest,"");
+        PVStructurePtr pvStructureCopy = pvCopy->createPVStructure();
+        BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+        PVScalarPtr pvValueRecord = pvStructureRecord->getSubField<PVScalar>("value");
+        PVScalarPtr pvValueCopy = pvStructureCopy->getSubField<PVScalar>("value");
+        pvCopy->initCopy(pvStructureCopy,bitSet);
+        bitSet->clear();
+        pvValueRecord->putFrom<string>(leafValue(scalarType,1));
+        bool changed = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        bitSet->clear();
+        bool unchanged = !pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        testOk(changed && unchanged
+            && pvValueCopy->getAs<string>()==pvValueRecord->getAs<string>(),
+            "scalar %s copy and compare",typeName.c_str());
+        epicsTime start = epicsTime::getCurrent();
+        for(int i=0; i<nloop; ++i) {
+            pvValueRecord->putFrom<string>(leafValue(scalarType,i));
+            pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        }
+        double elapsed = epicsTime::getCurrent() - start;
+        testDiag("scalar %s put+updateCopySetBitSet %g microseconds",
+            typeName.c_str(),elapsed*1e6/nloop);
+
+        pvRecord = createScalarArray(typeName + "ArrayRecord",scalarType,"");
+        pvStructureRecord = pvRecord->getPVRecordStructure()->getPVStructure();
+        pvCopy = PVCopy::create(pvStructureRecord,pvRequest,"");
+        pvStructureCopy = pvCopy->createPVStructure();
+        bitSet = BitSetPtr(new BitSet(pvStructureCopy->getNumberFields()));
+        PVScalarArrayPtr pvArrayRecord = pvStructureRecord->getSubField<PVScalarArray>("value");
+        PVScalarArrayPtr pvArrayCopy = pvStructureCopy->getSubField<PVScalarArray>("value");
+        pvCopy->initCopy(pvStructureCopy,bitSet);
+        bitSet->clear();
+        shared_vector<string> values(nelements,leafValue(scalarType,1));
+        shared_vector<const string> cvalues(freeze(values));
+        pvArrayRecord->putFrom(cvalues);
+        changed = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        // give the copy an equal but distinct buffer so that elements must be compared
+        shared_vector<string> distinct(nelements,leafValue(scalarType,1));
+        pvArrayCopy->putFrom(freeze(distinct));
+        bitSet->clear();
+        unchanged = !pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        shared_vector<const string> copyValues;
+        pvArrayCopy->getAs(copyValues);
+        testOk(changed && unchanged
+            && copyValues.size()==nelements && copyValues[0]==cvalues[0],
+            "scalarArray %s copy and compare",typeName.c_str());
+        start = epicsTime::getCurrent();
+        for(int i=0; i<nloop/100; ++i) {
+            pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        }
+        elapsed = epicsTime::getCurrent() - start;
+        testDiag("scalarArray %s compare %lu elements %g microseconds",
+            typeName.c_str(),(unsigned long)nelements,elapsed*1e6/(nloop/100));
+    }
+}
+
+static void moveArraysTest()
+{
+    if(debug) {cout << endl << endl << "****moveArraysTest****" << endl;}
+    PVRecordPtr pvRecord = createScalarArray("moveArraysRecord",pvDouble,"");
+    PVStructurePtr pvStructureRecord = pvRecord->getPVRecordStructure()->getPVStructure();
+    PVStructurePtr pvRequest = CreateRequest::create()->createRequest("value");
+    PVCopyPtr pvCopy = PVCopy::create(pvStructureRecord,pvRequest,"");
+    PVStructurePtr pvStructureCopy = pvCopy->createPVStructure();
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    PVDoubleArrayPtr pvValueRecord = pvStructureRecord->getSubField<PVDoubleArray>("value");
+    PVDoubleArrayPtr pvValueCopy = pvStructureCopy->getSubField<PVDoubleArray>("value");
+    size_t offset = pvValueCopy->getFieldOffset();
+
+    shared_vector<double> values(100,1.0);
+    shared_vector<const double> cvalues(freeze(values));
+    pvValueCopy->replace(cvalues);
+    bitSet->set(offset);
+    pvCopy->updateMaster(pvStructureCopy,bitSet);
+    testOk1(pvValueRecord->view().data()==cvalues.data());
+    testOk1(pvValueCopy->getLength()==100);
+
+    pvCopy->setMoveArrays(true);
+    shared_vector<double> more(100,2.0);
+    shared_vector<const double> cmore(freeze(more));
+    pvValueCopy->replace(cmore);
+    bitSet->set(offset);
+    pvCopy->updateMaster(pvStructureCopy,bitSet);
+    testOk1(pvValueRecord->view().data()==cmore.data());
+    testOk1(pvValueCopy->getLength()==0);
+
+    bitSet->clear();
+    bitSet->set(offset);
+    pvCopy->updateCopyFromBitSet(pvStructureCopy,bitSet);
+    testOk1(pvValueCopy->view().data()==cmore.data());
+}
+
 static void masterFieldTest()
 {
     if(debug) {
@@ -432,10 +547,12 @@ static void masterFieldTest()
 
 MAIN(testPVCopy)
 {
-    testPlan(71);
+    testPlan(100);
     scalarTest();
     arrayTest();
     powerSupplyTest();
     masterFieldTest();
+    leafKernelTest();
+    moveArraysTest();
     return 0;
 }
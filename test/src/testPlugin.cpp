@@ -19,11 +19,16 @@
 #include <cstdio>
 #include <memory>
 #include <iostream>
+#include <cmath>
+#include <sstream>
+#include <algorithm>
 
 #include <epicsStdio.h>
 #include <epicsMutex.h>
 #include <epicsEvent.h>
 #include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsMath.h>
 
 #include <pv/standardField.h>
 #include <pv/standardPVField.h>
@@ -31,6 +36,7 @@
 #include <pv/convert.h>
 #include <pv/pvStructureCopy.h>
 #include <pv/pvDatabase.h>
+#include <pv/pvCompressPlugin.h>
 #define epicsExportSharedSymbols
 #include "powerSupply.h"
 
@@ -100,6 +106,143 @@ static void deadbandTest()
     testOk1(nset==1);
 }
 
+// Puts value to the master, updates the copy and returns if the copy reports a change.
+static bool scalarDeadbandUpdate(
+    PVScalarPtr const & pvValue,int64 value,
+    PVCopyPtr const & pvCopy,PVStructurePtr const & pvStructureCopy,BitSetPtr const & bitSet)
+{
+    pvValue->putFrom<int64>(value);
+    bitSet->clear();
+    return pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+}
+
+static void scalarDeadbandTest()
+{
+    if(debug) {cout << endl << endl << "****scalarDeadbandTest****" << endl;}
+    // differences smaller than the spacing of doubles near 2^60
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalar(pvLong,""));
+    PVRecordPtr pvRecord(PVRecord::create("longRecord",pvRecordStructure));
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest("value[deadband=abs:2]"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    PVScalarPtr pvValue(pvRecordStructure->getSubField<PVScalar>("value"));
+    PVLongPtr pvCopyValue(pvStructureCopy->getSubField<PVLong>("value"));
+    const int64 big = int64(1)<<60;
+    bool first = scalarDeadbandUpdate(pvValue,big,pvCopy,pvStructureCopy,bitSet);
+    bool one = scalarDeadbandUpdate(pvValue,big+1,pvCopy,pvStructureCopy,bitSet);
+    bool copyOne = pvCopyValue->get()==big+1;
+    bool two = scalarDeadbandUpdate(pvValue,big+3,pvCopy,pvStructureCopy,bitSet);
+    if(debug) {
+        cout << "first " << first << " one " << one << " two " << two
+             << " copy " << pvCopyValue->get() << endl;
+    }
+    testOk(first && !one && two,"int64 deadband near 2^60");
+    testOk(copyOne && pvCopyValue->get()==big+3,"int64 copy is exact");
+}
+
+// Puts value + delta to all elements, or only element index if it is not npos,
+// then updates the copy and returns if the copy reports a change.
+static bool arrayDeadbandUpdate(
+    PVDoubleArrayPtr const & pvValue,double value,double delta,size_t index,
+    PVCopyPtr const & pvCopy,PVStructurePtr const & pvStructureCopy,BitSetPtr const & bitSet)
+{
+    const size_t n = 1000;
+    shared_vector<double> values(n,value);
+    for(size_t i=0; i<n; i++) {
+        if(index==string::npos || i==index) values[i] += delta;
+    }
+    pvValue->replace(freeze(values));
+    bitSet->clear();
+    return pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+}
+
+static void arrayDeadbandTest()
+{
+    if(debug) {cout << endl << endl << "****arrayDeadbandTest****" << endl;}
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalarArray(pvDouble,""));
+    PVRecordPtr pvRecord(PVRecord::create("doubleArrayRecord",pvRecordStructure));
+    PVDoubleArrayPtr pvValue(pvRecordStructure->getSubField<PVDoubleArray>("value"));
+    const char * requests[] = {"value[deadband=abs:0.5]","value[deadband=rms:0.5]","value[deadband=rel:1]"};
+    for(size_t k=0; k<sizeof(requests)/sizeof(requests[0]); ++k) {
+        PVStructurePtr pvRequest(CreateRequest::create()->createRequest(requests[k]));
+        PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+        PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+        BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+        bool first = arrayDeadbandUpdate(pvValue,100.0,0.0,string::npos,pvCopy,pvStructureCopy,bitSet);
+        // every element changes by 0.4, 0.4 percent
+        bool small = arrayDeadbandUpdate(pvValue,100.0,0.4,string::npos,pvCopy,pvStructureCopy,bitSet);
+        // one element changes by 10, rms 0.32, 0.32 percent
+        bool one = arrayDeadbandUpdate(pvValue,100.0,10.0,0,pvCopy,pvStructureCopy,bitSet);
+        // every element changes by 2, 2 percent
+        bool large = arrayDeadbandUpdate(pvValue,102.0,0.0,string::npos,pvCopy,pvStructureCopy,bitSet);
+        if(debug) {
+            cout << requests[k] << " first " << first << " small " << small
+                 << " one " << one << " large " << large << endl;
+        }
+        bool expectOne = (k==0);
+        testOk(first && !small && one==expectOne && large,"%s",requests[k]);
+    }
+}
+
+static void whereTest()
+{
+    if(debug) {cout << endl << endl << "****whereTest****" << endl;}
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalar(pvDouble,"alarm"));
+    PVRecordPtr pvRecord(PVRecord::create("doubleRecord",pvRecordStructure));
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest(
+        "value[where=alarm.severity>0&&value>10]"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    PVDoublePtr pvValue(pvRecordStructure->getSubField<PVDouble>("value"));
+    PVIntPtr pvSeverity(pvRecordStructure->getSubField<PVInt>("alarm.severity"));
+    size_t valueOffset = pvStructureCopy->getSubField("value")->getFieldOffset();
+    pvValue->put(20.0);
+    bool noAlarm = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    pvSeverity->put(1);
+    bitSet->clear();
+    bool alarm = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    // the value changed while the update was suppressed
+    bool held = bitSet->get(valueOffset)
+        && pvStructureCopy->getSubField<PVDouble>("value")->get()==20.0;
+    pvValue->put(5.0);
+    bitSet->clear();
+    bool small = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    bool smallEmpty = bitSet->nextSetBit(0)<0;
+    pvValue->put(15.0);
+    bitSet->clear();
+    bool large = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    if(debug) {
+        cout << "noAlarm " << noAlarm << " alarm " << alarm << " held " << held
+             << " small " << small << " large " << large << endl;
+    }
+    testOk(!noAlarm && alarm && held,"where reports the changes held back while false");
+    testOk(!small && smallEmpty && large,"where suppresses updates while false");
+    PVStructurePtr badRequest(CreateRequest::create()->createRequest("value[where=nofield>1]"));
+    PVCopyPtr badCopy(PVCopy::create(pvRecordStructure,badRequest,""));
+    PVStructurePtr badStructureCopy(badCopy->createPVStructure());
+    BitSetPtr badBitSet(new BitSet(badStructureCopy->getNumberFields()));
+    pvValue->put(16.0);
+    testOk(badCopy->updateCopySetBitSet(badStructureCopy,badBitSet),
+        "an expression with an unknown field is not used");
+    // 2^60 and 2^60+1 are the same double
+    PVStructurePtr pvLongStructure(getStandardPVField()->scalar(pvLong,""));
+    PVRecordPtr pvLongRecord(PVRecord::create("longRecord",pvLongStructure));
+    PVLongPtr pvLong(pvLongStructure->getSubField<PVLong>("value"));
+    PVStructurePtr longRequest(CreateRequest::create()->createRequest(
+        "value[where=value>1152921504606846976]"));
+    PVCopyPtr longCopy(PVCopy::create(pvLongStructure,longRequest,""));
+    PVStructurePtr longStructureCopy(longCopy->createPVStructure());
+    BitSetPtr longBitSet(new BitSet(longStructureCopy->getNumberFields()));
+    pvLong->put(int64(1)<<60);
+    bool equal = longCopy->updateCopySetBitSet(longStructureCopy,longBitSet);
+    pvLong->put((int64(1)<<60) + 1);
+    longBitSet->clear();
+    bool greater = longCopy->updateCopySetBitSet(longStructureCopy,longBitSet);
+    testOk(!equal && greater,"where compares int64 exactly");
+}
+
 static void arrayTest()
 {
     if(debug) {cout << endl << endl << "****arrayTest****" << endl;}
@@ -145,6 +288,300 @@ static void arrayTest()
     testOk1(nset==1);
 }
 
+static void arrayStrideTest()
+{
+    if(debug) {cout << endl << endl << "****arrayStrideTest****" << endl;}
+    const size_t n = 1000;
+    shared_vector<double> values(n);
+    for(size_t i=0; i<n; i++) values[i] = i;
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalarArray(pvDouble,""));
+    PVRecordPtr pvRecord(PVRecord::create("doubleArrayRecord",pvRecordStructure));
+    PVDoubleArrayPtr pvValue(pvRecordStructure->getSubField<PVDoubleArray>("value"));
+    pvValue->replace(freeze(values));
+    const long strides[] = {1,2,10,100};
+    for(size_t k=0; k<sizeof(strides)/sizeof(strides[0]); ++k) {
+        long stride = strides[k];
+        std::stringstream request;
+        request << "value[array=0:" << stride << ":-1]";
+        PVStructurePtr pvRequest(CreateRequest::create()->createRequest(request.str()));
+        PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+        PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+        BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+        PVDoubleArrayPtr pvCopyValue(pvStructureCopy->getSubField<PVDoubleArray>("value"));
+        pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        PVDoubleArray::const_svector copy(pvCopyValue->view());
+        bool ok = copy.size()==(n + stride - 1)/stride;
+        for(size_t i=0; ok && i<copy.size(); ++i) ok = copy[i]==double(i*stride);
+        testOk(ok,"stride %ld copies every %ld-th element",stride,stride);
+    }
+    // a put through a stride 10 copy only writes every tenth element
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest("value[array=0:10:99]"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    PVDoubleArrayPtr pvCopyValue(pvStructureCopy->getSubField<PVDoubleArray>("value"));
+    shared_vector<double> putValues(10,-1.0);
+    pvCopyValue->replace(freeze(putValues));
+    bitSet->set(pvCopyValue->getFieldOffset());
+    pvCopy->updateMaster(pvStructureCopy,bitSet);
+    PVDoubleArray::const_svector master(pvValue->view());
+    bool ok = master.size()==n;
+    for(size_t i=0; ok && i<100; ++i) ok = master[i]==((i%10==0) ? -1.0 : double(i));
+    testOk(ok,"stride 10 put writes every tenth element");
+}
+
+// Returns the value array of a copy of pvRecordStructure made with request.
+static PVDoubleArray::const_svector binCopy(PVStructurePtr const & pvRecordStructure,string const & request)
+{
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest(request));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    return pvStructureCopy->getSubField<PVDoubleArray>("value")->view();
+}
+
+static void binTest()
+{
+    if(debug) {cout << endl << endl << "****binTest****" << endl;}
+    size_t n = 100;
+    shared_vector<double> values(n);
+    for(size_t i=0; i<n; i++) values[i] = i%10;
+    values[37] = 50.0;
+    values[63] = -20.0;
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalarArray(pvDouble,""));
+    PVRecordPtr pvRecord(PVRecord::create("doubleArrayRecord",pvRecordStructure));
+    PVDoubleArrayPtr pvValue(pvRecordStructure->getSubField<PVDoubleArray>("value"));
+    pvValue->replace(freeze(values));
+    PVDoubleArray::const_svector copy = binCopy(pvRecordStructure,"value[bin=10:minmax]");
+    if(debug) {cout << "minmax " << copy << endl;}
+    testOk(copy.size()==20 && copy[6]==0.0 && copy[7]==50.0 && copy[12]==-20.0 && copy[13]==9.0,
+        "minmax keeps the peaks of each bin");
+    copy = binCopy(pvRecordStructure,"value[bin=10]");
+    if(debug) {cout << "mean " << copy << endl;}
+    testOk(copy.size()==10 && copy[0]==4.5 && std::fabs(copy[3] - 8.8)<1e-9,
+        "mean is the mean of each bin");
+    copy = binCopy(pvRecordStructure,"value[bin=12:lttb]");
+    if(debug) {cout << "lttb " << copy << endl;}
+    bool peaks = false;
+    bool valleys = false;
+    for(size_t i=0; i<copy.size(); ++i) {
+        if(copy[i]==50.0) peaks = true;
+        if(copy[i]==-20.0) valleys = true;
+    }
+    testOk(copy.size()==12 && copy[0]==0.0 && copy[11]==9.0 && peaks && valleys,
+        "lttb keeps the end points and the peaks");
+}
+
+// Creates a record structure with the value and dimension fields of an NTNDArray
+// that holds an nx by ny ushort image with value y*100+x.
+static PVStructurePtr createImage(size_t nx,size_t ny)
+{
+    FieldCreatePtr fieldCreate = getFieldCreate();
+    StructureConstPtr top = fieldCreate->createFieldBuilder()->
+        addNestedUnion("value") ->
+            addArray("ubyteValue",pvUByte) ->
+            addArray("ushortValue",pvUShort) ->
+            endNested()->
+        addNestedStructureArray("dimension") ->
+            add("size",pvInt) ->
+            add("offset",pvInt) ->
+            add("fullSize",pvInt) ->
+            add("binning",pvInt) ->
+            add("reverse",pvBoolean) ->
+            endNested()->
+        createStructure();
+    PVStructurePtr pvStructure(getPVDataCreate()->createPVStructure(top));
+    shared_vector<uint16> values(nx*ny);
+    for(size_t j=0; j<ny; ++j) {
+        for(size_t i=0; i<nx; ++i) values[j*nx + i] = static_cast<uint16>(j*100 + i);
+    }
+    pvStructure->getSubField<PVUnion>("value")->select<PVUShortArray>("ushortValue")->replace(freeze(values));
+    PVStructureArrayPtr pvDimension(pvStructure->getSubField<PVStructureArray>("dimension"));
+    PVStructureArray::svector dims(2);
+    size_t sizes[2] = {nx,ny};
+    for(size_t i=0; i<2; ++i) {
+        dims[i] = getPVDataCreate()->createPVStructure(pvDimension->getStructureArray()->getStructure());
+        dims[i]->getSubField<PVInt>("size")->put(static_cast<int32>(sizes[i]));
+        dims[i]->getSubField<PVInt>("fullSize")->put(static_cast<int32>(sizes[i]));
+        dims[i]->getSubField<PVInt>("binning")->put(1);
+    }
+    pvDimension->replace(freeze(dims));
+    return pvStructure;
+}
+
+static void roiTest()
+{
+    if(debug) {cout << endl << endl << "****roiTest****" << endl;}
+    PVStructurePtr pvRecordStructure(createImage(8,6));
+    PVRecordPtr pvRecord(PVRecord::create("imageRecord",pvRecordStructure));
+    const char * requests[] = {
+        "field(value[roi=6:4:0:0],dimension)",
+        "field(value[roi=2:1:4:4:2:2],dimension)"};
+    // each copy is 2 by 2
+    const uint16 expected[2][4] = {{406,407,506,507},{152,154,352,354}};
+    const int32 expectedOffset[2][2] = {{6,4},{2,1}};
+    const int32 expectedBinning[2] = {1,2};
+    for(size_t k=0; k<2; ++k) {
+        PVStructurePtr pvRequest(CreateRequest::create()->createRequest(requests[k]));
+        PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+        PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+        BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+        pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        if(debug) cout << requests[k] << "\n" << pvStructureCopy << endl;
+        PVUShortArray::const_svector copy(
+            pvStructureCopy->getSubField<PVUnion>("value")->get<PVUShortArray>()->view());
+        bool ok = copy.size()==4;
+        for(size_t i=0; ok && i<4; ++i) ok = copy[i]==expected[k][i];
+        PVStructureArray::const_svector dims(
+            pvStructureCopy->getSubField<PVStructureArray>("dimension")->view());
+        ok = ok && dims.size()==2;
+        for(size_t i=0; ok && i<2; ++i) {
+            ok = dims[i]->getSubField<PVInt>("size")->get()==2
+                && dims[i]->getSubField<PVInt>("offset")->get()==expectedOffset[k][i]
+                && dims[i]->getSubField<PVInt>("binning")->get()==expectedBinning[k];
+        }
+        testOk(ok,"%s",requests[k]);
+    }
+    // the region is smaller than one bin
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest(
+        "field(value[roi=7:5:1:1:2:2],dimension)"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    PVUShortArrayPtr pvEmpty(pvStructureCopy->getSubField<PVUnion>("value")->get<PVUShortArray>());
+    testOk(pvEmpty && pvEmpty->getLength()==0,"a region smaller than one bin is empty");
+    // a variant union is copied as is
+    FieldCreatePtr fieldCreate = getFieldCreate();
+    StructureConstPtr top = fieldCreate->createFieldBuilder()->
+        add("value",fieldCreate->createVariantUnion()) ->
+        add("dimension",pvRecordStructure->getSubField<PVStructureArray>("dimension")->getStructureArray()) ->
+        createStructure();
+    PVStructurePtr pvVariantStructure(getPVDataCreate()->createPVStructure(top));
+    pvVariantStructure->getSubField<PVUnion>("value")->set(
+        pvRecordStructure->getSubField<PVUnion>("value")->get());
+    pvVariantStructure->getSubField<PVStructureArray>("dimension")->copy(
+        *pvRecordStructure->getSubField<PVStructureArray>("dimension"));
+    pvCopy = PVCopy::create(pvVariantStructure,pvRequest,"");
+    pvStructureCopy = pvCopy->createPVStructure();
+    bitSet.reset(new BitSet(pvStructureCopy->getNumberFields()));
+    pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    PVUShortArrayPtr pvVariant(pvStructureCopy->getSubField<PVUnion>("value")->get<PVUShortArray>());
+    testOk(pvVariant && pvVariant->getLength()==48,"roi copies a variant union as is");
+}
+
+static void convertTest()
+{
+    if(debug) {cout << endl << endl << "****convertTest****" << endl;}
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalarArray(pvDouble,""));
+    PVRecordPtr pvRecord(PVRecord::create("convertRecord",pvRecordStructure));
+    shared_vector<double> values(6);
+    values[0] = 10.0; values[1] = 10.5; values[2] = 9.74;
+    values[3] = 1e9; values[4] = -1e9; values[5] = epicsNAN;
+    pvRecordStructure->getSubField<PVDoubleArray>("value")->replace(freeze(values));
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest("value[convert=float]"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    if(debug) cout << "value[convert=float]\n" << pvStructureCopy << endl;
+    PVFloatArrayPtr pvFloat(pvStructureCopy->getSubField<PVFloatArray>("value"));
+    bool ok = pvFloat && pvFloat->getLength()==6;
+    if(ok) {
+        PVFloatArray::const_svector copy(pvFloat->view());
+        ok = copy[1]==10.5f && copy[3]==1e9f && copy[5]!=copy[5];
+    }
+    testOk(ok,"value[convert=float]");
+    // (value - 10)/0.5 rounded and clipped, a NaN is the lowest value
+    pvRequest = CreateRequest::create()->createRequest("value[convert=short:0.5:10]");
+    pvCopy = PVCopy::create(pvRecordStructure,pvRequest,"");
+    pvStructureCopy = pvCopy->createPVStructure();
+    bitSet = BitSetPtr(new BitSet(pvStructureCopy->getNumberFields()));
+    pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    if(debug) cout << "value[convert=short:0.5:10]\n" << pvStructureCopy << endl;
+    const int16 expected[6] = {0,1,-1,32767,-32768,-32768};
+    PVShortArrayPtr pvShort(pvStructureCopy->getSubField<PVShortArray>("value"));
+    ok = pvShort && pvShort->getLength()==6;
+    if(ok) {
+        PVShortArray::const_svector copy(pvShort->view());
+        for(size_t i=0; ok && i<6; ++i) ok = copy[i]==expected[i];
+    }
+    testOk(ok,"value[convert=short:0.5:10]");
+    // the other plugins of a converted field are not used
+    const char * requests[] = {
+        "value[array=0:2:-1,convert=float]",
+        "value[bin=3,convert=float]",
+        "value[convert=float,compress=delta]"};
+    ok = true;
+    for(size_t k=0; k<sizeof(requests)/sizeof(requests[0]); ++k) {
+        pvRequest = CreateRequest::create()->createRequest(requests[k]);
+        pvCopy = PVCopy::create(pvRecordStructure,pvRequest,"");
+        pvStructureCopy = pvCopy->createPVStructure();
+        bitSet = BitSetPtr(new BitSet(pvStructureCopy->getNumberFields()));
+        pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+        pvFloat = pvStructureCopy->getSubField<PVFloatArray>("value");
+        if(!pvFloat || pvFloat->getLength()!=6 || pvFloat->view()[1]!=10.5f) ok = false;
+    }
+    testOk(ok,"convert is the only plugin of a converted field");
+}
+
+template<typename T>
+static bool compressRoundTrip(ScalarType type,shared_vector<T> & values)
+{
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalarArray(type,""));
+    std::tr1::shared_ptr<PVValueArray<T> > pvValue(
+        pvRecordStructure->getSubField<PVValueArray<T> >("value"));
+    typename PVValueArray<T>::const_svector master(freeze(values));
+    pvValue->replace(master);
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest("value[compress=delta]"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,""));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    PVUByteArrayPtr pvEncoded(pvStructureCopy->getSubField<PVUByteArray>("value"));
+    if(!pvEncoded) return false;
+    std::tr1::shared_ptr<PVValueArray<T> > pvDecoded(
+        std::tr1::dynamic_pointer_cast<PVValueArray<T> >(PVCompressPlugin::decode(pvEncoded->view())));
+    if(!pvDecoded) return false;
+    typename PVValueArray<T>::const_svector decoded(pvDecoded->view());
+    if(debug) {
+        cout << ScalarTypeFunc::name(type) << " " << master.size() << " elements "
+             << pvEncoded->getLength() << " bytes" << endl;
+    }
+    return decoded.size()==master.size()
+        && std::equal(decoded.begin(),decoded.end(),master.begin());
+}
+
+static void compressTest()
+{
+    if(debug) {cout << endl << endl << "****compressTest****" << endl;}
+    // a partial last block and differences that wrap around
+    shared_vector<int32> ints(300);
+    for(size_t i=0; i<ints.size(); ++i) ints[i] = i%2 ? 0x7fffffff : -0x7fffffff - 1;
+    ints[299] = -1;
+    testOk(compressRoundTrip<int32>(pvInt,ints),"compress int");
+    shared_vector<int64> longs(130);
+    for(size_t i=0; i<longs.size(); ++i) longs[i] = static_cast<int64>(i*i)*1000000007LL;
+    longs[0] = -0x7fffffffffffffffLL - 1;
+    testOk(compressRoundTrip<int64>(pvLong,longs),"compress long");
+    // a small detector frame, a peak on a background with noise
+    size_t width = 64;
+    size_t height = 64;
+    shared_vector<uint16> frame(width*height);
+    uint32 random = 1;
+    for(size_t y=0; y<height; ++y) {
+        for(size_t x=0; x<width; ++x) {
+            double dx = x - 32.0;
+            double dy = y - 32.0;
+            random = random*1103515245 + 12345;
+            frame[y*width + x] = static_cast<uint16>(
+                1000 + 800*exp(-(dx*dx + dy*dy)/200.0) + (random >> 28));
+        }
+    }
+    testOk(compressRoundTrip<uint16>(pvUShort,frame),"compress 64x64 ushort frame");
+}
+
 static void unionArrayTest()
 {
     if(debug) {cout << endl << endl << "****unionArrayTest****" << endl;}
@@ -264,6 +701,61 @@ static void timeStampTest()
     testOk1(nset==2);
 }
 
+static void sequenceTest()
+{
+    if(debug) {cout << endl << endl << "****sequenceTest****" << endl;}
+    PVStructurePtr pvRecordStructure(getStandardPVField()->scalar(pvDouble,"timeStamp"));
+    PVRecordPtr pvRecord(PVRecord::create("doubleRecord",pvRecordStructure));
+    PVStructurePtr pvRequest(CreateRequest::create()->createRequest("value,timeStamp.userTag[sequence=true]"));
+    PVCopyPtr pvCopy(PVCopy::create(pvRecordStructure,pvRequest,"",pvRecord->getSequenceNumberPtr()));
+    PVStructurePtr pvStructureCopy(pvCopy->createPVStructure());
+    BitSetPtr bitSet(new BitSet(pvStructureCopy->getNumberFields()));
+    PVDoublePtr pvValue(pvRecordStructure->getSubField<PVDouble>("value"));
+    PVIntPtr pvUserTag(pvRecordStructure->getSubField<PVInt>("timeStamp.userTag"));
+    PVIntPtr pvCopyUserTag(pvStructureCopy->getSubField<PVInt>("timeStamp.userTag"));
+    pvCopy->initCopy(pvStructureCopy,bitSet);
+    bitSet->clear();
+    pvRecord->lock();
+    pvRecord->beginGroupPut();
+    pvValue->put(1.0);
+    pvRecord->endGroupPut();
+    pvRecord->beginGroupPut();
+    pvValue->put(2.0);
+    pvRecord->endGroupPut();
+    uint64 sequenceNumber = pvRecord->getSequenceNumber();
+    pvRecord->unlock();
+    bool result = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    if(debug) {
+        cout << "after two group puts"
+             << " result " << (result ? "true" : "false")
+             << " bitSet " << *bitSet
+             << " pvStructureCopy\n" << pvStructureCopy
+             << "\n";
+    }
+    testOk1(result==true && sequenceNumber==2 && pvCopyUserTag->get()==2
+        && bitSet->get(pvCopyUserTag->getFieldOffset()));
+    pvCopyUserTag->put(99);
+    bitSet->clear();
+    bitSet->set(pvCopyUserTag->getFieldOffset());
+    pvCopy->updateMaster(pvStructureCopy,bitSet);
+    testOk1(pvUserTag->get()==0);
+    bitSet->clear();
+    pvRecord->lock();
+    pvValue->put(3.0);
+    pvValue->put(4.0);
+    sequenceNumber = pvRecord->getSequenceNumber();
+    pvRecord->unlock();
+    result = pvCopy->updateCopySetBitSet(pvStructureCopy,bitSet);
+    if(debug) {
+        cout << "after two puts outside a group"
+             << " result " << (result ? "true" : "false")
+             << " pvStructureCopy\n" << pvStructureCopy
+             << "\n";
+    }
+    testOk(result==true && sequenceNumber==4 && pvCopyUserTag->get()==4,
+        "each put outside a group is an update");
+}
+
 static void ignoreTest()
 {
     if(debug) {cout << endl << endl << "****ignoreTest****" << endl;}
@@ -447,12 +939,21 @@ static void dataDistributorTest()
 
 MAIN(testPlugin)
 {
-    testPlan(46);
+    testPlan(76);
     PVDatabasePtr pvDatabase(PVDatabase::getMaster());
     deadbandTest();
+    scalarDeadbandTest();
+    whereTest();
     arrayTest();
+    arrayDeadbandTest();
+    arrayStrideTest();
+    binTest();
+    roiTest();
+    convertTest();
+    compressTest();
     unionArrayTest();
     timeStampTest();
+    sequenceTest();
     ignoreTest();
     dataDistributorTest();
     return 0;